@@ -0,0 +1,139 @@
+#ifndef EXPRESSION_BATCH_IMPL_HPP
+#define EXPRESSION_BATCH_IMPL_HPP
+
+#include "counters.hpp"
+#include "expression.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <type_traits>
+
+namespace batch {
+
+template <typename T>
+std::vector<const T*> resolveColumns(const std::vector<std::string>& slots,
+                                     const ColumnSet<T>& inputs) {
+    std::vector<const T*> columns;
+    columns.reserve(slots.size());
+    for (const std::string& name : slots) {
+        const T* column = inputs.find(name);
+        if (!column) throw std::runtime_error("Undefined variable: " + name);
+        columns.push_back(column);
+    }
+    return columns;
+}
+
+// Векторные ядра для double и complex<double> (batch.cpp)
+void runReal(const std::vector<typename CompiledExpression<double>::Instruction>& program,
+             const std::vector<double>& constants, std::size_t registers,
+             const std::vector<std::uint32_t>& outputs, const std::vector<const double*>& columns,
+             const std::vector<double*>& outs, std::size_t n);
+void runComplex(
+    const std::vector<typename CompiledExpression<std::complex<double>>::Instruction>& program,
+    const std::vector<std::complex<double>>& constants, std::size_t registers,
+    const std::vector<std::uint32_t>& outputs,
+    const std::vector<const std::complex<double>*>& columns,
+    const std::vector<std::complex<double>*>& outs, std::size_t n);
+
+// Прочие типы значений: программа вычисляется построчно
+template <typename T>
+void runScalar(const CompiledExpression<T>& compiled, const std::vector<std::uint32_t>& outputs,
+               const std::vector<const T*>& columns, const std::vector<T*>& outs, std::size_t n) {
+    std::vector<T> values(columns.size());
+    std::vector<T> registers(compiled.registerCount());
+    for (std::size_t row = 0; row < n; ++row) {
+        for (std::size_t i = 0; i < columns.size(); ++i) values[i] = columns[i][row];
+        compiled.evaluate(values.data(), registers.data());
+        for (std::size_t k = 0; k < outputs.size(); ++k) outs[k][row] = registers[outputs[k]];
+    }
+}
+
+} // namespace batch
+
+// Пакетное вычисление
+template <typename T>
+void CompiledExpression<T>::evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n) const {
+    runBatch(inputs, {result}, &out, n, nullptr, 1);
+}
+
+template <typename T>
+void CompiledExpression<T>::evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n,
+                                          ThreadPool& pool, std::size_t threads) const {
+    runBatch(inputs, {result}, &out, n, &pool, threads);
+}
+
+template <typename T>
+void CompiledExpression<T>::evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n,
+                                          std::size_t threads) const {
+    runBatch(inputs, {result}, &out, n, &ThreadPool::shared(), threads);
+}
+
+template <typename T>
+void CompiledExpression<T>::evaluateBatchAll(const ColumnSet<T>& inputs, T* const* outs,
+                                             std::size_t n) const {
+    runBatch(inputs, outputs, outs, n, nullptr, 1);
+}
+
+template <typename T>
+void CompiledExpression<T>::evaluateBatchAll(const ColumnSet<T>& inputs, T* const* outs,
+                                             std::size_t n, ThreadPool& pool,
+                                             std::size_t threads) const {
+    runBatch(inputs, outputs, outs, n, &pool, threads);
+}
+
+template <typename T>
+void CompiledExpression<T>::runBatch(const ColumnSet<T>& inputs,
+                                     const std::vector<std::uint32_t>& registersOut,
+                                     T* const* outs, std::size_t n, ThreadPool* pool,
+                                     std::size_t threads) const {
+    CounterScope scope(ExpressionCounters::Operation::BATCH);
+    constexpr std::size_t block = batchBlock;
+    std::vector<const T*> columns = batch::resolveColumns(slots, inputs);
+    auto run = [&](std::size_t start, std::size_t m) {
+        std::vector<const T*> shifted(columns);
+        for (const T*& column : shifted) column += start;
+        std::vector<T*> targets(outs, outs + registersOut.size());
+        for (T*& target : targets) target += start;
+        if constexpr (std::is_same_v<T, double>) {
+            batch::runReal(program, constants, registers, registersOut, shifted, targets, m);
+        } else if constexpr (std::is_same_v<T, std::complex<double>>) {
+            batch::runComplex(program, constants, registers, registersOut, shifted, targets, m);
+        } else {
+            batch::runScalar(*this, registersOut, shifted, targets, m);
+        }
+    };
+    
+    // Фрагмент - целое число блоков, столбцы и результаты которого помещаются
+    // примерно в L2. Границы блоков те же, что при однопоточном вычислении,
+    // поэтому и результат побитово тот же.
+    constexpr std::size_t chunkBytes = std::size_t(1) << 18;
+    std::size_t blocks = (n + block - 1) / block;
+    std::size_t workers = pool ? std::min(threads ? threads : pool->size(), pool->size()) : 1;
+    std::size_t perChunk = std::max<std::size_t>(
+        1, chunkBytes / (block * sizeof(T) * (slots.size() + registersOut.size())));
+    // Не меньше четырёх фрагментов на поток, чтобы было что перераспределять
+    perChunk = std::max<std::size_t>(1, std::min(perChunk, blocks / (4 * workers)));
+    std::size_t chunks = (blocks + perChunk - 1) / perChunk;
+    if (workers <= 1 || chunks <= 1) {
+        run(0, n);
+        return;
+    }
+    
+    std::size_t rows = perChunk * block;
+    pool->parallelFor(chunks, [&](std::size_t chunk) {
+        std::size_t start = chunk * rows;
+        run(start, std::min(rows, n - start));
+    }, workers);
+}
+
+template <typename T>
+void Expression<T>::evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n) const {
+    compile().evaluateBatch(inputs, out, n);
+}
+
+template <typename T>
+void Expression<T>::evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n,
+                                  ThreadPool& pool, std::size_t threads) const {
+    compile().evaluateBatch(inputs, out, n, pool, threads);
+}
+
+#endif // EXPRESSION_BATCH_IMPL_HPP
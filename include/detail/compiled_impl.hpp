@@ -0,0 +1,436 @@
+#ifndef EXPRESSION_COMPILED_IMPL_HPP
+#define EXPRESSION_COMPILED_IMPL_HPP
+
+#include "expression.hpp"
+#include "node.hpp"
+#include "power.hpp"
+#include "trig.hpp"
+#include <unordered_map>
+#include <utility>
+
+// Компиляция дерева в плоскую программу
+template <typename T>
+CompiledExpression<T> Expression<T>::compile() const {
+    return compile(nullptr);
+}
+
+template <typename T>
+CompiledExpression<T> Expression<T>::bind(const std::vector<std::string>& variables) const {
+    return compile(&variables);
+}
+
+template <typename T>
+CompiledExpression<T> Expression<T>::compile(const std::vector<Expression>& outputs) {
+    return compile(outputs, nullptr);
+}
+
+template <typename T>
+CompiledExpression<T> Expression<T>::bind(const std::vector<Expression>& outputs,
+                                          const std::vector<std::string>& variables) {
+    return compile(outputs, &variables);
+}
+
+template <typename T>
+CompiledExpression<T> Expression<T>::compile(const std::vector<std::string>* binding) const {
+    return compile(std::vector<Expression>{*this}, binding);
+}
+
+template <typename T>
+CompiledExpression<T> Expression<T>::compile(const std::vector<Expression>& outputs,
+                                             const std::vector<std::string>* binding) {
+    CounterScope scope(ExpressionCounters::Operation::COMPILE);
+    using OpCode = typename CompiledExpression<T>::OpCode;
+    if (outputs.empty()) throw std::runtime_error("No expressions to compile");
+
+    // Постфиксный обход без рекурсии; общие узлы, в том числе общие для
+    // нескольких выходов, попадают в порядок один раз. Потомки n-арного узла
+    // добавляются в накопители сразу после вычисления каждого из них (шаг
+    // {node, k}), поэтому их регистры не живут до конца всего узла.
+    constexpr std::uint32_t whole = ~std::uint32_t(0);
+    constexpr std::uint32_t visit = whole - 1;
+    // Степень с постоянным показателем из быстрых путей: показатель входит в
+    // саму инструкцию, и его узел не вычисляется
+    auto special = [](const Node* node, int& n) {
+        if (node->type != Node::Type::POWER || node->right->type != Node::Type::CONSTANT)
+            return power::Kind::GENERAL;
+        return power::classify(node->right->value, n);
+    };
+    auto operands = [&](const Node* node) {
+        int n;
+        return special(node, n) != power::Kind::GENERAL ? std::size_t(1) : node->arity();
+    };
+    struct Step {
+        const Node* node;
+        // whole - сам узел, иначе номер потомка n-арного узла
+        std::uint32_t term;
+    };
+    std::unordered_map<const Node*, std::uint32_t> index;
+    std::vector<const Node*> order;
+    std::vector<Step> steps;
+    std::vector<Step> stack;
+    for (const Expression& output : outputs) {
+        stack.push_back({output.root.get(), visit});
+        while (!stack.empty()) {
+            Step step = stack.back();
+            stack.pop_back();
+            const Node* node = step.node;
+            if (step.term == visit) {
+                if (index.count(node)) continue;
+                stack.push_back({node, whole});
+                for (std::size_t k = operands(node); k-- > 0;) {
+                    if (node->terms) stack.push_back({node, static_cast<std::uint32_t>(k)});
+                    stack.push_back({node->child(k).get(), visit});
+                }
+                continue;
+            }
+            if (step.term == whole) {
+                if (index.count(node)) continue;
+                index.emplace(node, static_cast<std::uint32_t>(order.size()));
+                order.push_back(node);
+            }
+            steps.push_back(step);
+        }
+    }
+    // Число использований результата каждого узла. Выходы получают лишнее
+    // использование, поэтому их регистры не освобождаются до конца программы
+    std::vector<std::uint32_t> uses(order.size(), 0);
+    for (const Node* node : order) {
+        for (std::size_t k = 0; k < operands(node); ++k) ++uses[index[node->child(k).get()]];
+    }
+    for (const Expression& output : outputs) ++uses[index[output.root.get()]];
+    // Пары sin(u) и cos(u) с общим u (их порождают производные) вычисляются
+    // одной инструкцией SINCOS на месте первого из двух узлов
+    std::unordered_map<const Node*, std::pair<const Node*, const Node*>> trig;
+    for (const Node* node : order) {
+        if (node->type == Node::Type::SIN) trig[node->left.get()].first = node;
+        if (node->type == Node::Type::COS) trig[node->left.get()].second = node;
+    }
+    std::unordered_map<const Node*, const Node*> partner;
+    for (const auto& entry : trig) {
+        const auto& [sine, cosine] = entry.second;
+        if (!sine || !cosine) continue;
+        partner.emplace(sine, cosine);
+        partner.emplace(cosine, sine);
+    }
+    std::vector<bool> fused(order.size(), false);
+
+    CompiledExpression<T> compiled;
+    compiled.program.reserve(steps.size());
+    // Слоты по номеру имени в таблице символов
+    std::unordered_map<std::uint32_t, std::uint32_t> slotOf;
+    if (binding) {
+        for (const std::string& name : *binding) {
+            std::uint32_t symbol = SymbolTable::intern(name);
+            if (!slotOf.emplace(symbol, static_cast<std::uint32_t>(compiled.slots.size())).second)
+                throw std::runtime_error("Duplicate variable: " + name);
+            compiled.slots.push_back(name);
+        }
+    }
+    std::vector<std::uint32_t> reg(order.size());
+    std::vector<std::uint32_t> freeRegisters;
+
+    auto release = [&](const std::shared_ptr<Node>& child) {
+        std::uint32_t i = index[child.get()];
+        if (--uses[i] == 0) freeRegisters.push_back(reg[i]);
+    };
+    auto allocate = [&]() {
+        if (freeRegisters.empty()) return compiled.registers++;
+        std::uint32_t r = freeRegisters.back();
+        freeRegisters.pop_back();
+        return r;
+    };
+    auto emit = [&](OpCode op, std::uint32_t dst, std::uint32_t lhs, std::uint32_t rhs) {
+        compiled.program.push_back({op, dst, lhs, rhs});
+    };
+
+    // Состояние n-арного узла между шагами его потомков. Узлы вложены как
+    // вызовы, поэтому состояния лежат на стеке. Накопитель указывает на
+    // регистр потомка, пока в него не записана первая операция.
+    struct Accumulator {
+        const Node* node;
+        std::uint32_t acc[4];
+        bool owned[4];
+        // Потомок, на регистр которого указывает накопитель
+        std::uint32_t held[4];
+        std::uint32_t compensation, y, t;
+        std::vector<std::uint32_t> temporaries;
+    };
+    std::vector<Accumulator> accumulators;
+    auto temporary = [&](Accumulator& state) {
+        state.temporaries.push_back(allocate());
+        return state.temporaries.back();
+    };
+    auto drop = [&](Accumulator& state, std::size_t k) { release(state.node->child(k)); };
+    auto step = [&](Accumulator& state, OpCode op, std::size_t lane, std::uint32_t operand) {
+        std::uint32_t dst = state.owned[lane] ? state.acc[lane] : temporary(state);
+        emit(op, dst, state.acc[lane], operand);
+        state.acc[lane] = dst;
+        if (!state.owned[lane]) {
+            state.owned[lane] = true;
+            drop(state, state.held[lane]);
+        }
+    };
+    // Операции в порядке Node::reduce
+    auto accumulate = [&](Accumulator& state, std::uint32_t k) {
+        const Node* node = state.node;
+        std::size_t n = node->terms->size();
+        std::uint32_t operand = reg[index[node->child(k).get()]];
+        if (node->type == Node::Type::COMPENSATED_SUM) {
+            std::uint32_t& sum = state.acc[0];
+            if (k == 0) {
+                state.acc[0] = operand;
+                return;
+            }
+            if (k == 1) {
+                std::uint32_t first = sum;
+                sum = temporary(state);
+                emit(OpCode::ADD, sum, first, operand);
+                if (n > 2) {
+                    state.compensation = temporary(state);
+                    state.y = temporary(state);
+                    state.t = temporary(state);
+                    emit(OpCode::SUBTRACT, state.compensation, sum, first);
+                    emit(OpCode::SUBTRACT, state.compensation, state.compensation, operand);
+                    emit(OpCode::COMPENSATION, state.compensation, state.compensation, 0);
+                }
+                drop(state, 0);
+                drop(state, 1);
+                return;
+            }
+            // Поправка последнего шага не нужна, поэтому программа
+            // заканчивается сложением, дающим результат
+            emit(OpCode::SUBTRACT, state.y, operand, state.compensation);
+            emit(OpCode::ADD, state.t, sum, state.y);
+            if (k + 1 < n) {
+                emit(OpCode::SUBTRACT, state.compensation, state.t, sum);
+                emit(OpCode::SUBTRACT, state.compensation, state.compensation, state.y);
+                emit(OpCode::COMPENSATION, state.compensation, state.compensation, 0);
+            }
+            std::swap(sum, state.t);
+            drop(state, k);
+            return;
+        }
+        OpCode op = node->type == Node::Type::PRODUCT ? OpCode::MULTIPLY : OpCode::ADD;
+        std::size_t lane = n < 4 ? 0 : k % 4;
+        if (k < (n < 4 ? 1 : 4)) {
+            state.acc[lane] = operand;
+            state.held[lane] = k;
+            return;
+        }
+        step(state, op, lane, operand);
+        drop(state, k);
+    };
+    auto finish = [&](Accumulator& state) {
+        const Node* node = state.node;
+        if (node->type != Node::Type::COMPENSATED_SUM && node->terms->size() >= 4) {
+            OpCode op = node->type == Node::Type::PRODUCT ? OpCode::MULTIPLY : OpCode::ADD;
+            // Накопитель-операнд, ещё указывающий на потомка, отпускает его
+            // после инструкции, которая его читает
+            auto combine = [&](std::size_t lane, std::size_t other) {
+                step(state, op, lane, state.acc[other]);
+                if (!state.owned[other]) drop(state, state.held[other]);
+            };
+            combine(0, 1);
+            combine(2, 3);
+            combine(0, 2);
+        }
+        for (std::uint32_t r : state.temporaries) {
+            if (r != state.acc[0]) freeRegisters.push_back(r);
+        }
+        return state.acc[0];
+    };
+
+    for (const Step& current : steps) {
+        const Node* node = current.node;
+        if (current.term != whole) {
+            if (current.term == 0)
+                accumulators.push_back({node, {}, {false, false, false, false}, {}, 0, 0, 0, {}});
+            accumulate(accumulators.back(), current.term);
+            continue;
+        }
+        std::uint32_t i = index[node];
+        if (node->terms) {
+            reg[i] = finish(accumulators.back());
+            accumulators.pop_back();
+            continue;
+        }
+        if (fused[i]) continue;
+        auto twin = partner.find(node);
+        if (twin != partner.end()) {
+            std::uint32_t j = index[twin->second];
+            std::uint32_t argument = reg[index[node->left.get()]];
+            // Аргумент читают оба узла пары
+            release(node->left);
+            release(node->left);
+            reg[i] = allocate();
+            reg[j] = allocate();
+            fused[j] = true;
+            bool sine = node->type == Node::Type::SIN;
+            emit(OpCode::SINCOS, sine ? reg[i] : reg[j], argument, sine ? reg[j] : reg[i]);
+            continue;
+        }
+        typename CompiledExpression<T>::Instruction in{OpCode::CONSTANT, 0, 0, 0};
+        switch (node->type) {
+            case Node::Type::CONSTANT:
+                in.op = OpCode::CONSTANT;
+                in.lhs = static_cast<std::uint32_t>(compiled.constants.size());
+                compiled.constants.push_back(node->value);
+                break;
+            case Node::Type::VARIABLE: {
+                in.op = OpCode::VARIABLE;
+                auto it = slotOf.find(node->symbol);
+                if (it == slotOf.end()) {
+                    if (binding) throw std::runtime_error("Undefined variable: " + node->name());
+                    it = slotOf.emplace(node->symbol,
+                        static_cast<std::uint32_t>(compiled.slots.size())).first;
+                    compiled.slots.push_back(node->name());
+                }
+                in.lhs = it->second;
+                break;
+            }
+            case Node::Type::ADD: in.op = OpCode::ADD; break;
+            case Node::Type::SUBTRACT: in.op = OpCode::SUBTRACT; break;
+            case Node::Type::MULTIPLY: in.op = OpCode::MULTIPLY; break;
+            case Node::Type::DIVIDE: in.op = OpCode::DIVIDE; break;
+            case Node::Type::POWER: {
+                int n;
+                switch (special(node, n)) {
+                    case power::Kind::GENERAL: in.op = OpCode::POWER; break;
+                    case power::Kind::SQUARE: in.op = OpCode::SQUARE; break;
+                    case power::Kind::RECIPROCAL: in.op = OpCode::RECIPROCAL; break;
+                    case power::Kind::SQRT: in.op = OpCode::SQRT; break;
+                    case power::Kind::INTEGER: in.op = OpCode::POWI; break;
+                }
+                if (in.op != OpCode::POWER) {
+                    in.lhs = reg[index[node->left.get()]];
+                    in.rhs = static_cast<std::uint32_t>(n);
+                    release(node->left);
+                    reg[i] = allocate();
+                    in.dst = reg[i];
+                    compiled.program.push_back(in);
+                    continue;
+                }
+                break;
+            }
+            case Node::Type::SIN: in.op = OpCode::SIN; break;
+            case Node::Type::COS: in.op = OpCode::COS; break;
+            case Node::Type::EXP: in.op = OpCode::EXP; break;
+            case Node::Type::LOG: in.op = OpCode::LOG; break;
+            case Node::Type::NEGATE: in.op = OpCode::NEGATE; break;
+            case Node::Type::SUM:
+            case Node::Type::COMPENSATED_SUM:
+            case Node::Type::PRODUCT:
+                break;
+        }
+        if (node->left) in.lhs = reg[index[node->left.get()]];
+        if (node->right) in.rhs = reg[index[node->right.get()]];
+
+        // Регистры операндов освобождаются до выделения результата:
+        // инструкция читает операнды раньше, чем пишет dst
+        if (node->left) release(node->left);
+        if (node->right) release(node->right);
+
+        reg[i] = allocate();
+        in.dst = reg[i];
+        compiled.program.push_back(in);
+    }
+    for (const Expression& output : outputs)
+        compiled.outputs.push_back(reg[index[output.root.get()]]);
+    compiled.result = compiled.outputs.front();
+    return compiled;
+}
+
+// Вычисление скомпилированной программы
+template <typename T>
+T CompiledExpression<T>::evaluate(const std::map<std::string, T>& variables) const {
+    std::vector<T> values;
+    values.reserve(slots.size());
+    for (const std::string& name : slots) {
+        auto it = variables.find(name);
+        if (it == variables.end()) throw std::runtime_error("Undefined variable: " + name);
+        values.push_back(it->second);
+    }
+    return evaluate(values.data());
+}
+
+template <typename T>
+T CompiledExpression<T>::evaluate(const std::vector<T>& values) const {
+    if (values.size() != slots.size())
+        throw std::runtime_error("Expected " + std::to_string(slots.size()) +
+                                 " variable values, got " + std::to_string(values.size()));
+    return evaluate(values.data());
+}
+
+template <typename T>
+T CompiledExpression<T>::evaluate(const T* values) const {
+    if (registers <= inlineRegisters) {
+        T buffer[inlineRegisters];
+        return evaluate(values, buffer);
+    }
+    std::vector<T> buffer(registers);
+    return evaluate(values, buffer.data());
+}
+
+template <typename T>
+std::vector<T> CompiledExpression<T>::evaluateAll(const std::map<std::string, T>& variables) const {
+    std::vector<T> values;
+    values.reserve(slots.size());
+    for (const std::string& name : slots) {
+        auto it = variables.find(name);
+        if (it == variables.end()) throw std::runtime_error("Undefined variable: " + name);
+        values.push_back(it->second);
+    }
+    std::vector<T> out(outputs.size());
+    evaluateAll(values.data(), out.data());
+    return out;
+}
+
+template <typename T>
+void CompiledExpression<T>::evaluateAll(const T* values, T* out) const {
+    if (registers <= inlineRegisters) {
+        T buffer[inlineRegisters];
+        evaluateAll(values, out, buffer);
+        return;
+    }
+    std::vector<T> buffer(registers);
+    evaluateAll(values, out, buffer.data());
+}
+
+template <typename T>
+void CompiledExpression<T>::evaluateAll(const T* values, T* out, T* registers) const {
+    evaluate(values, registers);
+    for (std::size_t k = 0; k < outputs.size(); ++k) out[k] = registers[outputs[k]];
+}
+
+template <typename T>
+T CompiledExpression<T>::evaluate(const T* values, T* r) const {
+    CounterScope scope(ExpressionCounters::Operation::COMPILED_EVALUATE);
+    const T* c = constants.data();
+    for (const Instruction& in : program) {
+        switch (in.op) {
+            case OpCode::CONSTANT: r[in.dst] = c[in.lhs]; break;
+            case OpCode::VARIABLE: r[in.dst] = values[in.lhs]; break;
+            case OpCode::ADD: r[in.dst] = r[in.lhs] + r[in.rhs]; break;
+            case OpCode::SUBTRACT: r[in.dst] = r[in.lhs] - r[in.rhs]; break;
+            case OpCode::MULTIPLY: r[in.dst] = r[in.lhs] * r[in.rhs]; break;
+            case OpCode::DIVIDE: r[in.dst] = r[in.lhs] / r[in.rhs]; break;
+            case OpCode::POWER: r[in.dst] = scalar::pow(r[in.lhs], r[in.rhs]); break;
+            case OpCode::SIN: r[in.dst] = scalar::sin(r[in.lhs]); break;
+            case OpCode::COS: r[in.dst] = scalar::cos(r[in.lhs]); break;
+            case OpCode::EXP: r[in.dst] = scalar::exp(r[in.lhs]); break;
+            case OpCode::LOG: r[in.dst] = scalar::log(r[in.lhs]); break;
+            case OpCode::NEGATE: r[in.dst] = -r[in.lhs]; break;
+            case OpCode::SQUARE: r[in.dst] = power::square(r[in.lhs]); break;
+            case OpCode::RECIPROCAL: r[in.dst] = T(1) / r[in.lhs]; break;
+            case OpCode::SQRT: r[in.dst] = scalar::sqrt(r[in.lhs]); break;
+            case OpCode::POWI:
+                r[in.dst] = power::integer(r[in.lhs], static_cast<std::int32_t>(in.rhs));
+                break;
+            case OpCode::SINCOS: trig::sincos(r[in.lhs], r[in.dst], r[in.rhs]); break;
+            case OpCode::COMPENSATION: r[in.dst] = scalar::compensation(r[in.lhs]); break;
+        }
+    }
+    return r[result];
+}
+
+#endif // EXPRESSION_COMPILED_IMPL_HPP
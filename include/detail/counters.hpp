@@ -0,0 +1,57 @@
+#ifndef EXPRESSION_COUNTERS_INTERNAL_HPP
+#define EXPRESSION_COUNTERS_INTERNAL_HPP
+
+#include "expression_counters.hpp"
+#include <chrono>
+
+// Замеры внутри библиотеки: CounterScope на время публичного вызова и
+// countAllocation() при создании узла. Определения здесь не зависят от
+// EXPRESSION_COUNTERS: шаблоны из этих заголовков инстанцируются и в
+// программе пользователя, и их код должен совпадать с кодом библиотеки.
+// Макрос задаёт только counters::active в counters.cpp; без него замеры
+// сводятся к проверке этого флага.
+namespace counters {
+
+extern const bool active;
+
+void record(ExpressionCounters::Operation operation, std::uint64_t nanoseconds,
+            std::uint64_t allocations);
+
+// Узлы, созданные текущим потоком; CounterScope берёт разность
+inline std::uint64_t& allocated() {
+    thread_local std::uint64_t count = 0;
+    return count;
+}
+
+} // namespace counters
+
+inline void countAllocation() {
+    if (counters::active) ++counters::allocated();
+}
+
+class CounterScope {
+public:
+    explicit CounterScope(ExpressionCounters::Operation operation) : operation(operation) {
+        if (!counters::active) return;
+        allocations = counters::allocated();
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~CounterScope() {
+        if (!counters::active) return;
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        counters::record(operation,
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                         counters::allocated() - allocations);
+    }
+
+    CounterScope(const CounterScope&) = delete;
+    CounterScope& operator=(const CounterScope&) = delete;
+
+private:
+    ExpressionCounters::Operation operation;
+    std::uint64_t allocations = 0;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // EXPRESSION_COUNTERS_INTERNAL_HPP
@@ -0,0 +1,199 @@
+#ifndef EXPRESSION_DUAL_IMPL_HPP
+#define EXPRESSION_DUAL_IMPL_HPP
+
+#include "expression.hpp"
+#include "node.hpp"
+#include "power.hpp"
+#include "trig.hpp"
+
+namespace dual {
+
+// Правила прямого дифференцирования; общие для дерева и программы
+template <typename T>
+Dual<T> power(const Dual<T>& u, const Dual<T>& v) {
+    // d(u^v) = v u^(v-1) du + u^v log(u) dv; слагаемые с нулевым приращением
+    // пропускаются, чтобы постоянный показатель не требовал log(u)
+    T value = scalar::pow(u.value, v.value);
+    T derivative = T(0);
+    if (u.derivative != T(0))
+        derivative += v.value * scalar::pow(u.value, v.value - T(1)) * u.derivative;
+    if (v.derivative != T(0))
+        derivative += value * scalar::log(u.value) * v.derivative;
+    return {value, derivative};
+}
+
+// Степень с постоянным показателем по быстрым путям power
+template <typename T>
+Dual<T> constantPower(power::Kind kind, const Dual<T>& u, int n, const T& exponent) {
+    T value = power::apply(kind, u.value, n, exponent);
+    switch (kind) {
+        case power::Kind::SQUARE: return {value, (u.value + u.value) * u.derivative};
+        case power::Kind::RECIPROCAL: return {value, -(value * value) * u.derivative};
+        case power::Kind::SQRT: return {value, u.derivative / (value + value)};
+        case power::Kind::INTEGER:
+            if (n == 0) return {value, T(0)};
+            return {value, T(n) * power::integer(u.value, n - 1) * u.derivative};
+        case power::Kind::GENERAL: break;
+    }
+    return power(u, Dual<T>{exponent, T(0)});
+}
+
+template <typename T, typename Type>
+Dual<T> apply(Type type, const Dual<T>& u, const Dual<T>& v) {
+    switch (type) {
+        case Type::ADD: return {u.value + v.value, u.derivative + v.derivative};
+        case Type::SUBTRACT: return {u.value - v.value, u.derivative - v.derivative};
+        case Type::MULTIPLY:
+            return {u.value * v.value, u.derivative * v.value + u.value * v.derivative};
+        case Type::DIVIDE: {
+            // (u/v)' = (u' - (u/v) v')/v
+            T value = u.value / v.value;
+            return {value, (u.derivative - value * v.derivative) / v.value};
+        }
+        case Type::POWER: return power(u, v);
+        case Type::SIN: return {scalar::sin(u.value), scalar::cos(u.value) * u.derivative};
+        case Type::COS: return {scalar::cos(u.value), -scalar::sin(u.value) * u.derivative};
+        case Type::EXP: {
+            T value = scalar::exp(u.value);
+            return {value, value * u.derivative};
+        }
+        case Type::LOG: return {scalar::log(u.value), u.derivative / u.value};
+        case Type::NEGATE: return {-u.value, -u.derivative};
+        default: break;
+    }
+    return {T(0), T(0)};
+}
+
+} // namespace dual
+
+// Вычисление дуальных чисел по дереву
+template <typename T>
+struct Expression<T>::DualEvaluator {
+    const std::map<std::string, T>& values;
+    // Либо одна переменная с единичным приращением, либо карта приращений
+    std::uint32_t variable;
+    const std::map<std::string, T>* direction;
+
+    Dual<T> run(const Node* root) const {
+        return Node::template fold<Dual<T>>(root, [&](const Node* node, const Dual<T>* u,
+                                                      const Dual<T>* v) {
+            if (node->type == Node::Type::CONSTANT) return Dual<T>{node->value, T(0)};
+            if (node->type == Node::Type::VARIABLE) return leaf(node);
+            if (node->terms) return nary(node->type, u, node->arity());
+            if (node->type == Node::Type::POWER && node->right->type == Node::Type::CONSTANT) {
+                int n;
+                power::Kind kind = power::classify(node->right->value, n);
+                return dual::constantPower(kind, *u, n, node->right->value);
+            }
+            return dual::apply(node->type, *u, v ? *v : Dual<T>{T(0), T(0)});
+        });
+    }
+
+    // Значения получаются в том же порядке операций, что у Expression::evaluate
+    static Dual<T> nary(typename Node::Type type, const Dual<T>* items, std::size_t n) {
+        using Type = typename Node::Type;
+        if (type == Type::COMPENSATED_SUM) {
+            // Сумма линейна: значения и приращения суммируются по отдельности
+            std::vector<T> values(n), derivatives(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                values[i] = items[i].value;
+                derivatives[i] = items[i].derivative;
+            }
+            return {Node::reduce(type, values.data(), n),
+                    Node::reduce(type, derivatives.data(), n)};
+        }
+        Type op = type == Type::PRODUCT ? Type::MULTIPLY : Type::ADD;
+        return Node::lanes(items, n, [op](const Dual<T>& a, const Dual<T>& b) {
+            return dual::apply(op, a, b);
+        });
+    }
+
+    Dual<T> leaf(const Node* node) const {
+        const std::string& name = node->name();
+        auto it = values.find(name);
+        if (it == values.end()) throw std::runtime_error("Undefined variable: " + name);
+        T tangent = T(0);
+        if (direction) {
+            auto d = direction->find(name);
+            if (d != direction->end()) tangent = d->second;
+        } else if (node->symbol == variable) {
+            tangent = T(1);
+        }
+        return Dual<T>{it->second, tangent};
+    }
+};
+
+template <typename T>
+Dual<T> Expression<T>::evaluateDual(const std::string& variable,
+                                    const std::map<std::string, T>& values) const {
+    DualEvaluator evaluator{values, SymbolTable::find(variable), nullptr};
+    return evaluator.run(root.get());
+}
+
+template <typename T>
+Dual<T> Expression<T>::evaluateDirectional(const std::map<std::string, T>& values,
+                                           const std::map<std::string, T>& direction) const {
+    DualEvaluator evaluator{values, SymbolTable::none, &direction};
+    return evaluator.run(root.get());
+}
+
+// Вычисление дуальных чисел по программе
+template <typename T>
+Dual<T> CompiledExpression<T>::evaluateDual(const T* values, const T* tangents) const {
+    if (registers <= inlineRegisters) {
+        Dual<T> buffer[inlineRegisters];
+        return evaluateDual(values, tangents, buffer);
+    }
+    std::vector<Dual<T>> buffer(registers);
+    return evaluateDual(values, tangents, buffer.data());
+}
+
+template <typename T>
+Dual<T> CompiledExpression<T>::evaluateDual(const T* values, const T* tangents, Dual<T>* r) const {
+    for (const Instruction& in : program) {
+        switch (in.op) {
+            case OpCode::CONSTANT: r[in.dst] = {constants[in.lhs], T(0)}; break;
+            case OpCode::VARIABLE: r[in.dst] = {values[in.lhs], tangents[in.lhs]}; break;
+            case OpCode::ADD:
+            case OpCode::SUBTRACT:
+            case OpCode::MULTIPLY:
+            case OpCode::DIVIDE:
+            case OpCode::POWER:
+                r[in.dst] = dual::apply(in.op, r[in.lhs], r[in.rhs]);
+                break;
+            case OpCode::SQUARE:
+                r[in.dst] = dual::constantPower(power::Kind::SQUARE, r[in.lhs], 0, T(2));
+                break;
+            case OpCode::RECIPROCAL:
+                r[in.dst] = dual::constantPower(power::Kind::RECIPROCAL, r[in.lhs], 0, T(-1));
+                break;
+            case OpCode::SQRT:
+                r[in.dst] = dual::constantPower(power::Kind::SQRT, r[in.lhs], 0, T(0.5));
+                break;
+            case OpCode::POWI: {
+                int n = static_cast<std::int32_t>(in.rhs);
+                r[in.dst] = dual::constantPower(power::Kind::INTEGER, r[in.lhs], n, T(n));
+                break;
+            }
+            case OpCode::SINCOS: {
+                Dual<T> u = r[in.lhs];
+                T s, c;
+                trig::sincos(u.value, s, c);
+                r[in.dst] = {s, c * u.derivative};
+                r[in.rhs] = {c, -s * u.derivative};
+                break;
+            }
+            case OpCode::COMPENSATION:
+                // Как в Node::reduce, где значения и приращения суммируются отдельно
+                r[in.dst] = {scalar::compensation(r[in.lhs].value),
+                             scalar::compensation(r[in.lhs].derivative)};
+                break;
+            default:
+                r[in.dst] = dual::apply(in.op, r[in.lhs], Dual<T>{T(0), T(0)});
+                break;
+        }
+    }
+    return r[result];
+}
+
+#endif // EXPRESSION_DUAL_IMPL_HPP
@@ -0,0 +1,616 @@
+#ifndef EXPRESSION_EXPRESSION_IMPL_HPP
+#define EXPRESSION_EXPRESSION_IMPL_HPP
+
+#include "expression.hpp"
+#include "node.hpp"
+#include "power.hpp"
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+// Реализация методов Expression
+template <typename T>
+Expression<T>::Expression() : root(Node::make(Node::Type::CONSTANT, T(0))) {}
+
+template <typename T>
+Expression<T>::Expression(T value) : root(Node::make(Node::Type::CONSTANT, value)) {}
+
+template <typename T>
+Expression<T>::Expression(const std::string& variable) 
+    : root(Node::make(Node::Type::VARIABLE, variable)) {}
+
+template <typename T>
+Expression<T>::Expression(std::shared_ptr<Node> node) : root(std::move(node)) {}
+
+// Арифметические операции
+template <typename T>
+Expression<T> Expression<T>::operator+(Expression other) const& {
+    return Expression(Node::make(Node::Type::ADD, std::shared_ptr<Node>(root),
+                                 std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator+(Expression other) && {
+    return Expression(Node::make(Node::Type::ADD, std::move(root), std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator-(Expression other) const& {
+    return Expression(Node::make(Node::Type::SUBTRACT, std::shared_ptr<Node>(root),
+                                 std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator-(Expression other) && {
+    return Expression(Node::make(Node::Type::SUBTRACT, std::move(root), std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator*(Expression other) const& {
+    return Expression(Node::make(Node::Type::MULTIPLY, std::shared_ptr<Node>(root),
+                                 std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator*(Expression other) && {
+    return Expression(Node::make(Node::Type::MULTIPLY, std::move(root), std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator/(Expression other) const& {
+    return Expression(Node::make(Node::Type::DIVIDE, std::shared_ptr<Node>(root),
+                                 std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator/(Expression other) && {
+    return Expression(Node::make(Node::Type::DIVIDE, std::move(root), std::move(other.root)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator-() const& {
+    return Expression(Node::make(Node::Type::NEGATE, root));
+}
+
+template <typename T>
+Expression<T> Expression<T>::operator-() && {
+    return Expression(Node::make(Node::Type::NEGATE, std::move(root)));
+}
+
+template <typename T>
+Expression<T>& Expression<T>::operator+=(Expression other) {
+    root = Node::make(Node::Type::ADD, std::move(root), std::move(other.root));
+    return *this;
+}
+
+template <typename T>
+Expression<T>& Expression<T>::operator-=(Expression other) {
+    root = Node::make(Node::Type::SUBTRACT, std::move(root), std::move(other.root));
+    return *this;
+}
+
+template <typename T>
+Expression<T>& Expression<T>::operator*=(Expression other) {
+    root = Node::make(Node::Type::MULTIPLY, std::move(root), std::move(other.root));
+    return *this;
+}
+
+template <typename T>
+Expression<T>& Expression<T>::operator/=(Expression other) {
+    root = Node::make(Node::Type::DIVIDE, std::move(root), std::move(other.root));
+    return *this;
+}
+
+// n-арные суммы и произведения: один узел со всеми слагаемыми вместо цепочки
+template <typename T>
+Expression<T> Expression<T>::sum(const std::vector<Expression>& terms, Summation summation) {
+    auto type = summation == Summation::COMPENSATED ? Node::Type::COMPENSATED_SUM
+                                                    : Node::Type::SUM;
+    return Expression(Node::nary(type, roots(terms), T(0)));
+}
+
+template <typename T>
+Expression<T> Expression<T>::product(const std::vector<Expression>& factors) {
+    return Expression(Node::nary(Node::Type::PRODUCT, roots(factors), T(1)));
+}
+
+template <typename T>
+std::vector<std::shared_ptr<typename Expression<T>::Node>> Expression<T>::roots(
+    const std::vector<Expression>& items) {
+    std::vector<std::shared_ptr<Node>> result;
+    result.reserve(items.size());
+    for (const Expression& item : items) result.push_back(item.root);
+    return result;
+}
+
+// Математические функции
+template <typename T>
+Expression<T> Expression<T>::sin(const Expression& expr) {
+    return Expression(Node::make(Node::Type::SIN, expr.root));
+}
+
+template <typename T>
+Expression<T> Expression<T>::cos(const Expression& expr) {
+    return Expression(Node::make(Node::Type::COS, expr.root));
+}
+
+template <typename T>
+Expression<T> Expression<T>::exp(const Expression& expr) {
+    return Expression(Node::make(Node::Type::EXP, expr.root));
+}
+
+template <typename T>
+Expression<T> Expression<T>::log(const Expression& expr) {
+    return Expression(Node::make(Node::Type::LOG, expr.root));
+}
+
+template <typename T>
+Expression<T> Expression<T>::pow(const Expression& base, const Expression& exponent) {
+    return Expression(Node::make(Node::Type::POWER, base.root, exponent.root));
+}
+
+// Вычисление выражения
+//
+// Все обходы ниже идут через Node::fold или явный стек, поэтому глубина
+// выражения ограничена только памятью, а не стеком вызовов.
+template <typename T>
+T Expression<T>::evaluate(const std::map<std::string, T>& variables) const {
+    CounterScope scope(ExpressionCounters::Operation::EVALUATE);
+    return Node::template fold<T>(root.get(), [&](const Node* node, const T* l, const T* r) -> T {
+        switch (node->type) {
+            case Node::Type::CONSTANT:
+                return node->value;
+            case Node::Type::VARIABLE: {
+                auto it = variables.find(node->name());
+                if (it != variables.end()) return it->second;
+                throw std::runtime_error("Undefined variable: " + node->name());
+            }
+            case Node::Type::ADD: return *l + *r;
+            case Node::Type::SUBTRACT: return *l - *r;
+            case Node::Type::MULTIPLY: return *l * *r;
+            case Node::Type::DIVIDE: return *l / *r;
+            case Node::Type::POWER:
+                // Постоянный показатель - по тем же быстрым путям, что в программе
+                if (node->right->type == Node::Type::CONSTANT) return power::constant(*l, *r);
+                return scalar::pow(*l, *r);
+            case Node::Type::SIN: return scalar::sin(*l);
+            case Node::Type::COS: return scalar::cos(*l);
+            case Node::Type::EXP: return scalar::exp(*l);
+            case Node::Type::LOG: return scalar::log(*l);
+            case Node::Type::NEGATE: return -*l;
+            case Node::Type::SUM:
+            case Node::Type::COMPENSATED_SUM:
+            case Node::Type::PRODUCT:
+                return Node::reduce(node->type, l, node->arity());
+        }
+        return T(0);
+    });
+}
+
+// Вычисление производной
+template <typename T>
+Expression<T> Expression<T>::derivative(const std::string& variable, bool simplified) const {
+    CounterScope scope(ExpressionCounters::Operation::DERIVATIVE);
+    auto result = derivative(root, SymbolTable::find(variable));
+    return Expression(simplified ? simplify(result) : result);
+}
+
+template <typename T>
+Expression<T> Expression<T>::derivative(const std::string& variable, DerivativeContext<T>& context,
+                                        bool simplified) const {
+    CounterScope scope(ExpressionCounters::Operation::DERIVATIVE);
+    auto result = derivative(root, SymbolTable::find(variable), context.cache.get());
+    return Expression(simplified ? simplify(result) : result);
+}
+
+// Записи кэша владеют и узлом, и его производной: пока запись жива, адрес
+// узла не может достаться другому узлу
+template <typename T>
+struct DerivativeContext<T>::Cache {
+    using Node = typename Expression<T>::Node;
+    
+    struct Entry {
+        std::shared_ptr<Node> node;
+        std::shared_ptr<Node> derivative;
+    };
+    
+    struct KeyHash {
+        std::size_t operator()(const std::pair<const Node*, std::uint32_t>& key) const {
+            return std::hash<const Node*>()(key.first) ^
+                   (std::size_t(key.second) * 0x9e3779b97f4a7c15ULL);
+        }
+    };
+    
+    std::unordered_map<std::pair<const Node*, std::uint32_t>, Entry, KeyHash> entries;
+    
+    const std::shared_ptr<Node>* find(const Node* node, std::uint32_t variable) const {
+        auto it = entries.find({node, variable});
+        return it != entries.end() ? &it->second.derivative : nullptr;
+    }
+    
+    void store(const std::shared_ptr<Node>& node, std::uint32_t variable,
+               const std::shared_ptr<Node>& derivative) {
+        entries.emplace(std::make_pair(node.get(), variable), Entry{node, derivative});
+    }
+};
+
+template <typename T>
+DerivativeContext<T>::DerivativeContext() : cache(new Cache) {}
+
+template <typename T>
+DerivativeContext<T>::DerivativeContext(DerivativeContext&& other) noexcept = default;
+
+template <typename T>
+DerivativeContext<T>& DerivativeContext<T>::operator=(DerivativeContext&& other) noexcept = default;
+
+template <typename T>
+DerivativeContext<T>::~DerivativeContext() = default;
+
+template <typename T>
+std::size_t DerivativeContext<T>::size() const {
+    return cache ? cache->entries.size() : 0;
+}
+
+template <typename T>
+void DerivativeContext<T>::clear() {
+    if (cache) cache->entries.clear();
+}
+
+template <typename T>
+std::shared_ptr<typename Expression<T>::Node> Expression<T>::derivative(
+    const std::shared_ptr<Node>& root, std::uint32_t variable,
+    typename DerivativeContext<T>::Cache* cache)
+{
+    using Ptr = std::shared_ptr<Node>;
+    // Поддерево без переменной не обходится: его производная - ноль
+    const Ptr zero = Node::make(Node::Type::CONSTANT, T(0));
+    auto lookup = [&](const Node* node) -> const Ptr* {
+        if (!node->mayDependOn(variable)) return &zero;
+        return cache ? cache->find(node, variable) : nullptr;
+    };
+    auto isZero = [](const Ptr& node) {
+        return node->type == Node::Type::CONSTANT && node->value == T(0);
+    };
+    Ptr result = Node::template fold<Ptr>(root.get(), [&](const Node* node, const Ptr* dl,
+                                                          const Ptr* dr) -> Ptr {
+        // Потомки запоминаются здесь, где доступны владеющие указатели на них
+        if (cache) {
+            for (std::size_t i = 0; i < node->arity(); ++i)
+                cache->store(node->child(i), variable, dl[i]);
+        }
+        switch (node->type) {
+            case Node::Type::CONSTANT:
+                return Node::make(Node::Type::CONSTANT, T(0));
+            case Node::Type::VARIABLE:
+                return Node::make(Node::Type::CONSTANT, 
+                    (node->symbol == variable) ? T(1) : T(0));
+            case Node::Type::ADD:
+            case Node::Type::SUBTRACT:
+                return Node::make(node->type, *dl, *dr);
+            case Node::Type::MULTIPLY: {
+                // (uv)' = u'v + uv'
+                const auto& u = node->left;
+                const auto& v = node->right;
+                auto term1 = Node::make(Node::Type::MULTIPLY, *dl, v);
+                auto term2 = Node::make(Node::Type::MULTIPLY, u, *dr);
+                return Node::make(Node::Type::ADD, term1, term2);
+            }
+            case Node::Type::DIVIDE: {
+                // (u/v)' = (u'v - uv')/v^2
+                const auto& u = node->left;
+                const auto& v = node->right;
+                auto num1 = Node::make(Node::Type::MULTIPLY, *dl, v);
+                auto num2 = Node::make(Node::Type::MULTIPLY, u, *dr);
+                auto numerator = Node::make(Node::Type::SUBTRACT, num1, num2);
+                auto denominator = Node::make(Node::Type::POWER, v, 
+                    Node::make(Node::Type::CONSTANT, T(2)));
+                return Node::make(Node::Type::DIVIDE, numerator, denominator);
+            }
+            case Node::Type::POWER: {
+                const auto& u = node->left;
+                const auto& v = node->right;
+                if (v->variables == 0) {
+                    // (u^n)' = n*u^(n-1)*u'
+                    T n = Expression<T>(v).evaluate();
+                    auto term1 = Node::make(Node::Type::CONSTANT, n);
+                    auto term2 = Node::make(Node::Type::POWER, u, 
+                        Node::make(Node::Type::CONSTANT, n - T(1)));
+                    auto part = Node::make(Node::Type::MULTIPLY, term1, term2);
+                    return Node::make(Node::Type::MULTIPLY, part, *dl);
+                }
+                if (isZero(*dr)) {
+                    // Показатель зависит от других переменных: (u^v)' = v*u^(v-1)*u'
+                    auto lowered = Node::make(Node::Type::SUBTRACT, v,
+                        Node::make(Node::Type::CONSTANT, T(1)));
+                    auto part = Node::make(Node::Type::MULTIPLY, v,
+                        Node::make(Node::Type::POWER, u, std::move(lowered)));
+                    return Node::make(Node::Type::MULTIPLY, std::move(part), *dl);
+                }
+                // (u^v)' = u^v * (v' * log(u) + v * u'/u); при u' = 0 второе
+                // слагаемое не нужно
+                // Хэш-консинг вернёт сам узел u^v
+                auto value = Node::make(Node::Type::POWER, u, v);
+                auto growth = Node::make(Node::Type::MULTIPLY, *dr, Node::make(Node::Type::LOG, u));
+                if (!isZero(*dl)) {
+                    auto base = Node::make(Node::Type::DIVIDE,
+                        Node::make(Node::Type::MULTIPLY, v, *dl), u);
+                    growth = Node::make(Node::Type::ADD, std::move(growth), std::move(base));
+                }
+                return Node::make(Node::Type::MULTIPLY, std::move(value), std::move(growth));
+            }
+            case Node::Type::SIN: {
+                auto cos_u = Node::make(Node::Type::COS, node->left);
+                return Node::make(Node::Type::MULTIPLY, cos_u, *dl);
+            }
+            case Node::Type::COS: {
+                auto sin_u = Node::make(Node::Type::SIN, node->left);
+                auto neg_sin = Node::make(Node::Type::NEGATE, sin_u);
+                return Node::make(Node::Type::MULTIPLY, neg_sin, *dl);
+            }
+            case Node::Type::EXP: {
+                auto exp_u = Node::make(Node::Type::EXP, node->left);
+                return Node::make(Node::Type::MULTIPLY, exp_u, *dl);
+            }
+            case Node::Type::LOG:
+                return Node::make(Node::Type::DIVIDE, *dl, node->left);
+            case Node::Type::NEGATE:
+                return Node::make(Node::Type::NEGATE, *dl);
+            case Node::Type::SUM:
+            case Node::Type::COMPENSATED_SUM: {
+                // Сумма производных того же вида; нулевые слагаемые отбрасываются
+                std::vector<Ptr> terms;
+                for (std::size_t i = 0; i < node->arity(); ++i) {
+                    if (!isZero(dl[i])) terms.push_back(dl[i]);
+                }
+                return Node::nary(node->type, std::move(terms), T(0));
+            }
+            case Node::Type::PRODUCT: {
+                // (u1...un)' = sum ui' * (u1...u(i-1)) * (u(i+1)...un); произведения
+                // остальных множителей собираются из префиксов и суффиксов за O(n)
+                const auto& factors = *node->terms;
+                std::size_t n = factors.size();
+                std::vector<Ptr> suffix(n + 1);
+                for (std::size_t i = n; i-- > 1;) {
+                    suffix[i] = suffix[i + 1]
+                        ? Node::make(Node::Type::MULTIPLY, factors[i], suffix[i + 1])
+                        : factors[i];
+                }
+                std::vector<Ptr> terms;
+                Ptr prefix;
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (!isZero(dl[i])) {
+                        Ptr others = !prefix ? suffix[i + 1]
+                            : suffix[i + 1]
+                                ? Node::make(Node::Type::MULTIPLY, prefix, suffix[i + 1])
+                                : prefix;
+                        terms.push_back(Node::make(Node::Type::MULTIPLY, dl[i], others));
+                    }
+                    prefix = prefix ? Node::make(Node::Type::MULTIPLY, prefix, factors[i])
+                                    : factors[i];
+                }
+                return Node::nary(Node::Type::SUM, std::move(terms), T(0));
+            }
+        }
+        return Node::make(Node::Type::CONSTANT, T(0));
+    }, lookup);
+    if (cache) cache->store(root, variable, result);
+    return result;
+}
+
+// Подстановка значения переменной
+template <typename T>
+Expression<T> Expression<T>::substitute(const std::string& variable,
+                                        const Expression& value) const {
+    CounterScope scope(ExpressionCounters::Operation::SUBSTITUTE);
+    std::uint32_t symbol = SymbolTable::find(variable);
+    if (symbol == SymbolTable::none) return *this;
+    return Expression(substitute(root, {{symbol, value.root}}));
+}
+
+template <typename T>
+Expression<T> Expression<T>::substitute(const std::map<std::string, Expression>& values) const {
+    CounterScope scope(ExpressionCounters::Operation::SUBSTITUTE);
+    // Имена, которых нет в таблице символов, не встречаются ни в одном выражении
+    std::vector<std::pair<std::uint32_t, std::shared_ptr<Node>>> symbols;
+    for (const auto& [name, value] : values) {
+        std::uint32_t symbol = SymbolTable::find(name);
+        if (symbol != SymbolTable::none) symbols.emplace_back(symbol, value.root);
+    }
+    if (symbols.empty()) return *this;
+    std::sort(symbols.begin(), symbols.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    return Expression(substitute(root, symbols));
+}
+
+template <typename T>
+std::shared_ptr<typename Expression<T>::Node> Expression<T>::substitute(
+    const std::shared_ptr<Node>& root,
+    const std::vector<std::pair<std::uint32_t, std::shared_ptr<Node>>>& values)
+{
+    // nullptr означает, что подвыражение не изменилось: родитель без
+    // изменённых потомков тоже возвращает nullptr и не пересоздаётся.
+    // Общие поддеревья fold обходит один раз, а поддеревья без подставляемых
+    // переменных (по маске узла) не обходятся вовсе.
+    using Ptr = std::shared_ptr<Node>;
+    std::uint64_t mask = 0;
+    for (const auto& entry : values) mask |= Node::bit(entry.first);
+    const Ptr unchanged;
+    auto skip = [&](const Node* node) -> const Ptr* {
+        return (node->variables & mask) == 0 ? &unchanged : nullptr;
+    };
+    Ptr result = Node::template fold<Ptr>(root.get(), [&](const Node* node, const Ptr* newLeft,
+                                                          const Ptr* newRight) -> Ptr {
+        if (node->type == Node::Type::VARIABLE) {
+            auto it = std::lower_bound(values.begin(), values.end(), node->symbol,
+                                       [](const auto& entry, std::uint32_t symbol) {
+                                           return entry.first < symbol;
+                                       });
+            if (it != values.end() && it->first == node->symbol) return it->second;
+            return nullptr;
+        }
+        if (node->terms) {
+            std::size_t n = node->arity();
+            if (std::none_of(newLeft, newLeft + n, [](const Ptr& term) { return bool(term); }))
+                return nullptr;
+            std::vector<Ptr> terms(n);
+            for (std::size_t i = 0; i < n; ++i) terms[i] = newLeft[i] ? newLeft[i] : node->child(i);
+            return Node::make(node->type, std::move(terms));
+        }
+        bool changedLeft = newLeft && *newLeft;
+        bool changedRight = newRight && *newRight;
+        if (!changedLeft && !changedRight) return nullptr;
+        
+        return Node::make(node->type, 
+            changedLeft ? *newLeft : node->left,
+            changedRight ? *newRight : node->right);
+    }, skip);
+    return result ? result : root;
+}
+
+// Преобразование в строку
+template <typename T>
+struct Expression<T>::Printer {
+    // Задание: узел для печати (в скобках или без) или готовый фрагмент текста
+    struct Task {
+        const Node* node;
+        const char* text;
+        bool wrap;
+    };
+    
+    // Поток получает текст частями этого размера
+    static constexpr std::size_t chunk = std::size_t(1) << 16;
+    
+    Parentheses parentheses;
+    std::string& out;
+    std::ostream* stream;
+    
+    // Приоритет узла как операнда: атомы и вызовы функций связывают сильнее всего
+    static int precedence(const Node* node) {
+        switch (node->type) {
+            case Node::Type::ADD:
+            case Node::Type::SUBTRACT:
+            case Node::Type::SUM:
+            case Node::Type::COMPENSATED_SUM: return 1;
+            case Node::Type::MULTIPLY:
+            case Node::Type::DIVIDE:
+            case Node::Type::PRODUCT: return 2;
+            default: return 3;
+        }
+    }
+    
+    void flush() {
+        if (stream) {
+            stream->write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    
+    void run(const Node* root) {
+        bool minimal = parentheses == Parentheses::MINIMAL;
+        std::vector<Task> stack{{root, nullptr, false}};
+        while (!stack.empty()) {
+            if (stream && out.size() >= chunk) flush();
+            Task task = stack.back();
+            stack.pop_back();
+            if (!task.node) {
+                out += task.text;
+                continue;
+            }
+            const Node* node = task.node;
+            const char* op = nullptr;
+            switch (node->type) {
+                case Node::Type::CONSTANT:
+                    ScalarTraits<T>::format(out, node->value);
+                    continue;
+                case Node::Type::VARIABLE:
+                    out += node->name();
+                    continue;
+                case Node::Type::ADD: op = " + "; break;
+                case Node::Type::SUBTRACT: op = " - "; break;
+                case Node::Type::MULTIPLY: op = " * "; break;
+                case Node::Type::DIVIDE: op = " / "; break;
+                case Node::Type::POWER: op = ", "; break;
+                case Node::Type::SIN: out += "sin("; break;
+                case Node::Type::COS: out += "cos("; break;
+                case Node::Type::EXP: out += "exp("; break;
+                case Node::Type::LOG: out += "log("; break;
+                case Node::Type::NEGATE: {
+                    // -x без скобок допустим, только если операнд не константа:
+                    // иначе -2 прочиталось бы как отрицательная константа
+                    const Node* operand = node->left.get();
+                    if (minimal && operand->type != Node::Type::CONSTANT &&
+                        precedence(operand) == 3) {
+                        out += '-';
+                        stack.push_back({operand, nullptr, false});
+                        continue;
+                    }
+                    out += "-(";
+                    break;
+                }
+                case Node::Type::SUM:
+                case Node::Type::COMPENSATED_SUM: op = " + "; break;
+                case Node::Type::PRODUCT: op = " * "; break;
+            }
+            if (node->type == Node::Type::POWER) {
+                out += "pow(";
+                stack.push_back({nullptr, ")", false});
+                stack.push_back({node->right.get(), nullptr, false});
+                stack.push_back({nullptr, op, false});
+                stack.push_back({node->left.get(), nullptr, false});
+            } else if (op) {
+                // Задания кладутся в обратном порядке. Операции левоассоциативны,
+                // поэтому операнды после первого того же приоритета берутся в скобки
+                bool wrap = !minimal || task.wrap;
+                int own = precedence(node);
+                if (wrap) {
+                    out += '(';
+                    stack.push_back({nullptr, ")", false});
+                }
+                for (std::size_t i = node->arity(); i-- > 0;) {
+                    const Node* operand = node->child(i).get();
+                    int inner = precedence(operand);
+                    stack.push_back({operand, nullptr, i == 0 ? inner < own : inner <= own});
+                    if (i > 0) stack.push_back({nullptr, op, false});
+                }
+            } else {
+                stack.push_back({nullptr, ")", false});
+                stack.push_back({node->left.get(), nullptr, false});
+            }
+        }
+        flush();
+    }
+};
+
+template <typename T>
+std::string Expression<T>::toString(Parentheses parentheses) const {
+    std::string out;
+    Printer{parentheses, out, nullptr}.run(root.get());
+    return out;
+}
+
+template <typename T>
+void Expression<T>::print(std::ostream& stream, Parentheses parentheses) const {
+    std::string out;
+    out.reserve(Printer::chunk + 64);
+    Printer{parentheses, out, &stream}.run(root.get());
+}
+
+// Проверки
+template <typename T>
+bool Expression<T>::isConstant() const {
+    return root->variables == 0;
+}
+
+template <typename T>
+bool Expression<T>::isVariable() const {
+    return root->type == Node::Type::VARIABLE;
+}
+
+template <typename T>
+bool Expression<T>::isVariable(const std::string& var) const {
+    return root->type == Node::Type::VARIABLE && root->symbol == SymbolTable::find(var);
+}
+
+#endif // EXPRESSION_EXPRESSION_IMPL_HPP
@@ -0,0 +1,177 @@
+#ifndef EXPRESSION_GRADIENT_IMPL_HPP
+#define EXPRESSION_GRADIENT_IMPL_HPP
+
+#include "expression.hpp"
+#include "power.hpp"
+#include "trig.hpp"
+
+// Градиент обратным проходом.
+// Регистры программы переиспользуются, поэтому прямой проход пишет значение
+// каждой инструкции в отдельную ячейку и запоминает, какие инструкции дали её
+// операнды. Обратный проход идёт по программе с конца и накапливает сопряжённые
+// значения; для VARIABLE они складываются в gradient[slot]. Косинус SINCOS
+// получает отдельную ячейку после ячеек всех инструкций.
+template <typename T>
+T CompiledExpression<T>::gradient(const T* values, T* gradient) const {
+    std::size_t count = program.size();
+    std::size_t cells = count;
+    for (const Instruction& in : program) cells += in.op == OpCode::SINCOS;
+    std::vector<T> v(cells);
+    std::vector<T> adjoint(cells, T(0));
+    std::vector<std::uint32_t> lhs(count), rhs(count);
+    // Ячейка, последней записанная в регистр
+    std::vector<std::uint32_t> owner(registers);
+    std::uint32_t extra = static_cast<std::uint32_t>(count);
+
+    const T* c = constants.data();
+    for (std::size_t i = 0; i < count; ++i) {
+        const Instruction& in = program[i];
+        // У CONSTANT и VARIABLE lhs - не регистр, rhs - регистр только у бинарных
+        bool leaf = in.op == OpCode::CONSTANT || in.op == OpCode::VARIABLE;
+        bool binary = in.op >= OpCode::ADD && in.op <= OpCode::POWER;
+        std::uint32_t a = leaf ? 0 : owner[in.lhs], b = binary ? owner[in.rhs] : 0;
+        switch (in.op) {
+            case OpCode::CONSTANT: v[i] = c[in.lhs]; break;
+            case OpCode::VARIABLE: v[i] = values[in.lhs]; break;
+            case OpCode::ADD: v[i] = v[a] + v[b]; break;
+            case OpCode::SUBTRACT: v[i] = v[a] - v[b]; break;
+            case OpCode::MULTIPLY: v[i] = v[a] * v[b]; break;
+            case OpCode::DIVIDE: v[i] = v[a] / v[b]; break;
+            case OpCode::POWER: v[i] = scalar::pow(v[a], v[b]); break;
+            case OpCode::SIN: v[i] = scalar::sin(v[a]); break;
+            case OpCode::COS: v[i] = scalar::cos(v[a]); break;
+            case OpCode::EXP: v[i] = scalar::exp(v[a]); break;
+            case OpCode::LOG: v[i] = scalar::log(v[a]); break;
+            case OpCode::NEGATE: v[i] = -v[a]; break;
+            case OpCode::SQUARE: v[i] = power::square(v[a]); break;
+            case OpCode::RECIPROCAL: v[i] = T(1) / v[a]; break;
+            case OpCode::SQRT: v[i] = scalar::sqrt(v[a]); break;
+            case OpCode::POWI:
+                v[i] = power::integer(v[a], static_cast<std::int32_t>(in.rhs));
+                break;
+            case OpCode::SINCOS:
+                b = extra++;
+                trig::sincos(v[a], v[i], v[b]);
+                owner[in.rhs] = b;
+                break;
+            case OpCode::COMPENSATION: v[i] = scalar::compensation(v[a]); break;
+        }
+        lhs[i] = a;
+        rhs[i] = b;
+        owner[in.dst] = static_cast<std::uint32_t>(i);
+    }
+
+    for (std::size_t s = 0; s < slots.size(); ++s) gradient[s] = T(0);
+    if (count == 0) return T(0);
+    adjoint[owner[result]] = T(1);
+
+    for (std::size_t i = count; i-- > 0;) {
+        const Instruction& in = program[i];
+        T g = adjoint[i];
+        std::uint32_t a = lhs[i], b = rhs[i];
+        switch (in.op) {
+            case OpCode::CONSTANT:
+                break;
+            case OpCode::VARIABLE:
+                gradient[in.lhs] += g;
+                break;
+            case OpCode::ADD:
+                adjoint[a] += g;
+                adjoint[b] += g;
+                break;
+            case OpCode::SUBTRACT:
+                adjoint[a] += g;
+                adjoint[b] -= g;
+                break;
+            case OpCode::MULTIPLY:
+                adjoint[a] += g * v[b];
+                adjoint[b] += g * v[a];
+                break;
+            case OpCode::DIVIDE:
+                // (u/v)' = u'/v - u v'/v^2
+                adjoint[a] += g / v[b];
+                adjoint[b] -= g * v[i] / v[b];
+                break;
+            case OpCode::POWER:
+                // d(u^v) = v u^(v-1) du + u^v log(u) dv; второе слагаемое
+                // нужно, только если показатель зависит от переменных
+                adjoint[a] += g * v[b] * scalar::pow(v[a], v[b] - T(1));
+                if (b >= count || program[b].op != OpCode::CONSTANT)
+                    adjoint[b] += g * v[i] * scalar::log(v[a]);
+                break;
+            case OpCode::SIN:
+                adjoint[a] += g * scalar::cos(v[a]);
+                break;
+            case OpCode::COS:
+                adjoint[a] -= g * scalar::sin(v[a]);
+                break;
+            case OpCode::EXP:
+                adjoint[a] += g * v[i];
+                break;
+            case OpCode::LOG:
+                adjoint[a] += g / v[a];
+                break;
+            case OpCode::NEGATE:
+                adjoint[a] -= g;
+                break;
+            case OpCode::SQUARE:
+                adjoint[a] += g * (v[a] + v[a]);
+                break;
+            case OpCode::RECIPROCAL:
+                // (1/u)' = -1/u^2
+                adjoint[a] -= g * v[i] * v[i];
+                break;
+            case OpCode::SQRT:
+                adjoint[a] += g / (v[i] + v[i]);
+                break;
+            case OpCode::POWI: {
+                std::int32_t n = static_cast<std::int32_t>(in.rhs);
+                if (n != 0) adjoint[a] += g * T(n) * power::integer(v[a], n - 1);
+                break;
+            }
+            case OpCode::SINCOS:
+                // b - ячейка косинуса: d sin = cos du, d cos = -sin du
+                adjoint[a] += g * v[b] - adjoint[b] * v[i];
+                break;
+            case OpCode::COMPENSATION:
+                if (ScalarTraits<T>::finite(v[a])) adjoint[a] += g;
+                break;
+        }
+    }
+    return v[owner[result]];
+}
+
+template <typename T>
+std::vector<T> CompiledExpression<T>::gradient(const std::map<std::string, T>& variables) const {
+    std::vector<T> values;
+    values.reserve(slots.size());
+    for (const std::string& name : slots) {
+        auto it = variables.find(name);
+        if (it == variables.end()) throw std::runtime_error("Undefined variable: " + name);
+        values.push_back(it->second);
+    }
+    std::vector<T> result(slots.size());
+    gradient(values.data(), result.data());
+    return result;
+}
+
+template <typename T>
+std::vector<T> Expression<T>::gradient(const std::vector<std::string>& variables,
+                                       const std::map<std::string, T>& values) const {
+    // Переменные, от которых выражение не зависит, получают нулевую производную;
+    // остальные переменные выражения берутся из values как параметры
+    CompiledExpression<T> compiled = compile();
+    std::vector<T> all = compiled.gradient(values);
+    std::map<std::string, T> bySlot;
+    for (std::size_t i = 0; i < all.size(); ++i) bySlot.emplace(compiled.variables()[i], all[i]);
+
+    std::vector<T> result;
+    result.reserve(variables.size());
+    for (const std::string& name : variables) {
+        auto it = bySlot.find(name);
+        result.push_back(it != bySlot.end() ? it->second : T(0));
+    }
+    return result;
+}
+
+#endif // EXPRESSION_GRADIENT_IMPL_HPP
@@ -0,0 +1,41 @@
+#ifndef EXPRESSION_HESSIAN_IMPL_HPP
+#define EXPRESSION_HESSIAN_IMPL_HPP
+
+#include "expression.hpp"
+
+// Матрица Якоби
+template <typename T>
+std::vector<Expression<T>> Expression<T>::jacobian(const std::vector<Expression>& functions,
+                                                   const std::vector<std::string>& variables,
+                                                   bool simplified) {
+    DerivativeContext<T> context;
+    std::vector<Expression> result;
+    result.reserve(functions.size() * variables.size());
+    for (const Expression& function : functions) {
+        for (const std::string& variable : variables) {
+            result.push_back(function.derivative(variable, context, simplified));
+        }
+    }
+    return result;
+}
+
+// Матрица Гессе
+template <typename T>
+std::vector<Expression<T>> Expression<T>::hessian(const std::vector<std::string>& variables,
+                                                  bool simplified) const {
+    // Вторые производные берутся от первых: узлы, общие для разных
+    // d/dx_i, дифференцируются по каждой переменной один раз благодаря кэшу
+    DerivativeContext<T> context;
+    std::size_t n = variables.size();
+    std::vector<Expression> result(n * n);
+    for (std::size_t i = 0; i < n; ++i) {
+        Expression first = derivative(variables[i], context, simplified);
+        for (std::size_t j = i; j < n; ++j) {
+            result[i * n + j] = first.derivative(variables[j], context, simplified);
+            result[j * n + i] = result[i * n + j];
+        }
+    }
+    return result;
+}
+
+#endif // EXPRESSION_HESSIAN_IMPL_HPP
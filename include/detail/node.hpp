@@ -0,0 +1,455 @@
+#ifndef EXPRESSION_NODE_HPP
+#define EXPRESSION_NODE_HPP
+
+#include "counters.hpp"
+#include "expression.hpp"
+#include "symbols.hpp"
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Определение структуры Node
+//
+// Узлы неизменяемы и создаются только через Node::make, который хэш-консингом
+// возвращает уже существующий узел с тем же типом, значением, переменной и
+// потомками. Поэтому структурно равные подвыражения - это один и тот же узел,
+// а сравнение подвыражений сводится к сравнению указателей.
+//
+// Имя переменной хранится номером в SymbolTable. Поля упорядочены по убыванию
+// выравнивания: узел занимает 80 байт для double и 88 для complex<double>.
+//
+// Сведения о поддереве (маска переменных, глубина, размер) вычисляются один
+// раз в конструкторе из сведений потомков, поэтому проверки "зависит ли от x"
+// и "константа ли это" не обходят поддерево.
+//
+// SUM, COMPENSATED_SUM и PRODUCT - n-арные узлы: потомки (не меньше двух)
+// лежат подряд в terms, а left и right пусты.
+template <typename T>
+struct Expression<T>::Node {
+    using Symbol = SymbolTable::Symbol;
+
+    enum class Type : std::uint8_t {
+        CONSTANT,
+        VARIABLE,
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        POWER,
+        SIN,
+        COS,
+        EXP,
+        LOG,
+        NEGATE,
+        SUM,
+        COMPENSATED_SUM,
+        PRODUCT
+    };
+
+    std::shared_ptr<Node> left;
+    std::shared_ptr<Node> right;
+    std::unique_ptr<std::vector<std::shared_ptr<Node>>> terms;
+    T value;
+    // Структурный хэш, вычисляется из хэшей потомков
+    std::size_t hash;
+    // Бит symbol % 64 для каждой переменной поддерева: нулевой бит переменной
+    // гарантирует, что поддерево от неё не зависит; variables == 0 - константа
+    std::uint64_t variables;
+    // Номер имени для VARIABLE, SymbolTable::none для остальных узлов
+    Symbol symbol;
+    // Узлов на самом длинном пути до листа и узлов в развёрнутом дереве;
+    // оба насыщаются на UINT32_MAX
+    std::uint32_t depth;
+    std::uint32_t size;
+    Type type;
+
+    Node(Type t, T val)
+        : value(val), variables(0), symbol(SymbolTable::none), depth(1), size(1), type(t) {}
+    Node(Type t, Symbol var)
+        : value(), variables(bit(var)), symbol(var), depth(1), size(1), type(t) {}
+    Node(Type t, std::shared_ptr<Node> l, std::shared_ptr<Node> r)
+        : left(std::move(l)), right(std::move(r)), value(), symbol(SymbolTable::none), type(t) {
+        measure();
+    }
+    Node(Type t, std::shared_ptr<Node> l)
+        : left(std::move(l)), value(), symbol(SymbolTable::none), type(t) {
+        measure();
+    }
+    Node(Type t, std::vector<std::shared_ptr<Node>> children)
+        : terms(new std::vector<std::shared_ptr<Node>>(std::move(children))), value(),
+          symbol(SymbolTable::none), type(t) {
+        measure();
+    }
+
+    Node(const Node&) = delete;
+    Node& operator=(const Node&) = delete;
+
+    ~Node() {
+        Table::instance().remove(this);
+        release();
+    }
+
+    const std::string& name() const {
+        return SymbolTable::name(symbol);
+    }
+
+    // Потомки по порядку, одинаково для унарных, бинарных и n-арных узлов
+    std::size_t arity() const {
+        if (terms) return terms->size();
+        return right ? 2 : left ? 1 : 0;
+    }
+
+    const std::shared_ptr<Node>& child(std::size_t i) const {
+        if (terms) return (*terms)[i];
+        return i == 0 ? left : right;
+    }
+
+    static std::uint64_t bit(Symbol var) {
+        return std::uint64_t(1) << (var % 64);
+    }
+
+    // false - поддерево точно не содержит переменной var
+    bool mayDependOn(Symbol var) const {
+        return var != SymbolTable::none && (variables & bit(var)) != 0;
+    }
+
+    // Сведения о поддереве из сведений потомков
+    void measure() {
+        constexpr std::uint64_t limit = UINT32_MAX;
+        std::uint64_t total = 1;
+        std::uint32_t deepest = 0;
+        variables = 0;
+        for (std::size_t i = 0, n = arity(); i < n; ++i) {
+            const Node& c = *child(i);
+            variables |= c.variables;
+            total += c.size;
+            if (c.depth > deepest) deepest = c.depth;
+        }
+        size = static_cast<std::uint32_t>(total < limit ? total : limit);
+        depth = deepest < limit ? deepest + 1 : deepest;
+    }
+
+    static std::shared_ptr<Node> make(Type t, T val) {
+        return Table::instance().intern(Key{t, &val, SymbolTable::none, nullptr, nullptr});
+    }
+
+    static std::shared_ptr<Node> make(Type t, Symbol var) {
+        return Table::instance().intern(Key{t, nullptr, var, nullptr, nullptr});
+    }
+
+    static std::shared_ptr<Node> make(Type t, const std::string& var) {
+        return make(t, SymbolTable::intern(var));
+    }
+
+    static std::shared_ptr<Node> make(Type t, const std::shared_ptr<Node>& l,
+                                      const std::shared_ptr<Node>& r) {
+        return Table::instance().intern(Key{t, nullptr, SymbolTable::none, &l, &r});
+    }
+
+    static std::shared_ptr<Node> make(Type t, const std::shared_ptr<Node>& l) {
+        return Table::instance().intern(Key{t, nullptr, SymbolTable::none, &l, nullptr});
+    }
+
+    // Потомки-rvalue переносятся в новый узел без лишних операций со счётчиками
+    static std::shared_ptr<Node> make(Type t, std::shared_ptr<Node>&& l, std::shared_ptr<Node>&& r) {
+        return Table::instance().intern(Key{t, nullptr, SymbolTable::none, &l, &r, true});
+    }
+
+    static std::shared_ptr<Node> make(Type t, std::shared_ptr<Node>&& l) {
+        return Table::instance().intern(Key{t, nullptr, SymbolTable::none, &l, nullptr, true});
+    }
+
+    // n-арный узел; потомков должно быть не меньше двух
+    static std::shared_ptr<Node> make(Type t, const std::vector<std::shared_ptr<Node>>& children) {
+        return Table::instance().intern(
+            Key{t, nullptr, SymbolTable::none, nullptr, nullptr, false, &children});
+    }
+
+    static std::shared_ptr<Node> make(Type t, std::vector<std::shared_ptr<Node>>&& children) {
+        return Table::instance().intern(
+            Key{t, nullptr, SymbolTable::none, nullptr, nullptr, true, &children});
+    }
+
+    // n-арный узел, если потомков больше одного; иначе единственный потомок
+    // или константа empty
+    static std::shared_ptr<Node> nary(Type t, std::vector<std::shared_ptr<Node>>&& children,
+                                      T empty) {
+        if (children.empty()) return make(Type::CONSTANT, empty);
+        if (children.size() == 1) return std::move(children.front());
+        return make(t, std::move(children));
+    }
+
+    // Свёртка значений потомков n-арного узла. SUM и PRODUCT ведут четыре
+    // независимых накопителя (потомок i попадает в накопитель i % 4), чтобы
+    // соседние операции не ждали друг друга; COMPENSATED_SUM суммирует по
+    // Кахану. Скомпилированная программа выполняет те же операции в том же
+    // порядке, поэтому результаты совпадают побитово. Неконечная поправка
+    // Кахана заменяется нулём (scalar::compensation), чтобы бесконечное
+    // слагаемое давало inf, как в обычной сумме, а не NaN.
+    template <typename V>
+    static V reduce(Type type, const V* items, std::size_t n) {
+        if (type == Type::COMPENSATED_SUM) {
+            using scalar::compensation;
+            V sum = items[0] + items[1];
+            V correction = compensation((sum - items[0]) - items[1]);
+            for (std::size_t i = 2; i < n; ++i) {
+                V y = items[i] - correction;
+                V t = sum + y;
+                correction = compensation((t - sum) - y);
+                sum = t;
+            }
+            return sum;
+        }
+        if (type == Type::PRODUCT) return lanes(items, n, std::multiplies<V>());
+        return lanes(items, n, std::plus<V>());
+    }
+
+    template <typename V, typename Op>
+    static V lanes(const V* items, std::size_t n, Op op) {
+        if (n < 4) {
+            V result = op(items[0], items[1]);
+            if (n == 3) result = op(result, items[2]);
+            return result;
+        }
+        V a0 = items[0], a1 = items[1], a2 = items[2], a3 = items[3];
+        std::size_t i = 4;
+        for (; i + 4 <= n; i += 4) {
+            a0 = op(a0, items[i]);
+            a1 = op(a1, items[i + 1]);
+            a2 = op(a2, items[i + 2]);
+            a3 = op(a3, items[i + 3]);
+        }
+        if (i < n) a0 = op(a0, items[i++]);
+        if (i < n) a1 = op(a1, items[i++]);
+        if (i < n) a2 = op(a2, items[i]);
+        return op(op(a0, a1), op(a2, a3));
+    }
+
+    // Обход без рекурсии: visit(node, left, right) вызывается для каждого узла
+    // DAG один раз, после потомков; left и right - результаты для потомков
+    // (nullptr, если потомка нет). У n-арного узла left - массив результатов
+    // всех arity() потомков, а right == nullptr. Возвращает результат для root.
+    //
+    // Результаты лежат на стеке значений. В таблицу запоминаются только узлы,
+    // у которых больше одного владельца: узел с единственным владельцем
+    // достижим из root лишь одним путём и встретится в обходе один раз.
+    template <typename R, typename Visit>
+    static R fold(const Node* root, Visit&& visit) {
+        return fold<R>(root, std::forward<Visit>(visit), [](const Node*) -> const R* {
+            return nullptr;
+        });
+    }
+
+    // То же с внешним кэшем: если lookup(node) возвращает не nullptr, это
+    // готовый результат для node, и его поддерево не обходится
+    template <typename R, typename Visit, typename Lookup>
+    static R fold(const Node* root, Visit&& visit, Lookup&& lookup) {
+        struct Frame {
+            const Node* node;
+            bool shared;
+            bool expanded;
+        };
+        std::unordered_map<const Node*, R> memo;
+        std::vector<R> values;
+        std::vector<Frame> stack{{root, false, false}};
+        auto finish = [&](const Frame& frame, R value) {
+            if (frame.shared) memo.emplace(frame.node, value);
+            values.push_back(std::move(value));
+        };
+        while (!stack.empty()) {
+            Frame frame = stack.back();
+            const Node* node = frame.node;
+            if (frame.expanded) {
+                stack.pop_back();
+                std::size_t arity = node->arity();
+                const R* l = &values[values.size() - arity];
+                const R* r = arity == 2 && !node->terms ? l + 1 : nullptr;
+                R value = visit(node, l, r);
+                values.resize(values.size() - arity);
+                finish(frame, std::move(value));
+                continue;
+            }
+            if (frame.shared) {
+                auto it = memo.find(node);
+                if (it != memo.end()) {
+                    stack.pop_back();
+                    values.push_back(it->second);
+                    continue;
+                }
+            }
+            if (const R* known = lookup(node)) {
+                stack.pop_back();
+                finish(frame, *known);
+                continue;
+            }
+            std::size_t arity = node->arity();
+            if (arity == 0) {
+                stack.pop_back();
+                finish(frame, visit(node, nullptr, nullptr));
+                continue;
+            }
+            stack.back().expanded = true;
+            // Левый потомок обрабатывается первым
+            for (std::size_t i = arity; i-- > 0;) {
+                const std::shared_ptr<Node>& child = node->child(i);
+                stack.push_back({child.get(), child.use_count() > 1, false});
+            }
+        }
+        return std::move(values.back());
+    }
+
+    // Константы сравниваются побитово, чтобы NaN и -0 тоже разделялись корректно
+    static bool sameValue(const T& a, const T& b) {
+        return ScalarTraits<T>::same(a, b);
+    }
+
+    static std::size_t hashValue(const T& value) {
+        return ScalarTraits<T>::hash(value);
+    }
+
+    // Описание узла для поиска в таблице без создания временного Node
+    struct Key {
+        Type type;
+        const T* value;
+        Symbol variable;
+        const std::shared_ptr<Node>* left;
+        const std::shared_ptr<Node>* right;
+        // Потомков можно забрать: make получил их как rvalue
+        bool movable = false;
+        const std::vector<std::shared_ptr<Node>>* terms = nullptr;
+
+        std::size_t hash() const {
+            std::size_t h = (static_cast<std::size_t>(type) + 1) * 0x9e3779b97f4a7c15ULL;
+            if (value) h ^= hashValue(*value);
+            if (variable != SymbolTable::none) h ^= (variable + 1) * 0xff51afd7ed558ccdULL;
+            if (left && *left) h = (h ^ (*left)->hash) * 0x100000001b3ULL;
+            if (right && *right) h = (h ^ ((*right)->hash + 0x632be59bd9b4e019ULL)) * 0x100000001b3ULL;
+            if (terms) {
+                for (const std::shared_ptr<Node>& child : *terms)
+                    h = (h ^ child->hash) * 0x100000001b3ULL + 0x632be59bd9b4e019ULL;
+            }
+            return h ^ (h >> 29);
+        }
+
+        bool matches(const Node& node) const {
+            if (node.type != type) return false;
+            if (value) return sameValue(node.value, *value);
+            if (variable != SymbolTable::none) return node.symbol == variable;
+            if (terms) return node.terms && *node.terms == *terms;
+            return node.left == *left && node.right == (right ? *right : nullptr);
+        }
+
+        std::shared_ptr<Node> create() const {
+            countAllocation();
+            if (value) return std::make_shared<Node>(type, *value);
+            if (variable != SymbolTable::none) return std::make_shared<Node>(type, variable);
+            if (terms) {
+                if (movable)
+                    return std::make_shared<Node>(
+                        type, std::move(*const_cast<std::vector<std::shared_ptr<Node>>*>(terms)));
+                return std::make_shared<Node>(type, *terms);
+            }
+            if (right) return std::make_shared<Node>(type, take(left), take(right));
+            return std::make_shared<Node>(type, take(left));
+        }
+
+        std::shared_ptr<Node> take(const std::shared_ptr<Node>* child) const {
+            if (movable) return std::move(*const_cast<std::shared_ptr<Node>*>(child));
+            return *child;
+        }
+    };
+
+    // Освобождение потомков без рекурсии: длинная цепочка узлов, которыми
+    // больше никто не владеет, разбирается циклом в самом внешнем деструкторе
+    void release() {
+        // Указатель, а не сам вектор: у него нет деструктора, и он безопасен
+        // для узлов, разрушаемых при выходе из программы
+        thread_local std::vector<std::shared_ptr<Node>>* pending = nullptr;
+        std::vector<std::shared_ptr<Node>> local;
+        std::vector<std::shared_ptr<Node>>& out = pending ? *pending : local;
+        auto drop = [&](std::shared_ptr<Node>& child) {
+            if (child && child.use_count() == 1) out.push_back(std::move(child));
+        };
+        drop(left);
+        drop(right);
+        if (terms) {
+            for (std::shared_ptr<Node>& child : *terms) drop(child);
+        }
+        if (pending || local.empty()) return;
+        pending = &local;
+        while (!local.empty()) {
+            std::shared_ptr<Node> node = std::move(local.back());
+            local.pop_back();
+            node.reset();
+        }
+        pending = nullptr;
+    }
+
+    // Таблица живых узлов. Записи хранят сырой указатель и weak_ptr; узел
+    // удаляет свою запись в деструкторе до разрушения полей, поэтому под
+    // блокировкой сегмента поля любого найденного узла корректны, даже если
+    // узел уже умирает (тогда lock() вернёт пустой указатель).
+    class Table {
+    public:
+        using Entry = std::pair<const Node*, std::weak_ptr<Node>>;
+
+        // Память на запись таблицы: элемент unordered_multimap и его корзина
+        static constexpr std::size_t entryBytes =
+            sizeof(std::pair<const std::size_t, Entry>) + 2 * sizeof(void*);
+
+        static Table& instance() {
+            // Не разрушается при выходе, чтобы статические выражения могли пережить таблицу
+            static Table* table = new Table;
+            return *table;
+        }
+
+        std::shared_ptr<Node> intern(const Key& key) {
+            std::size_t hash = key.hash();
+            Shard& shard = shardOf(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto range = shard.nodes.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (key.matches(*it->second.first)) {
+                    std::shared_ptr<Node> node = it->second.second.lock();
+                    if (node) return node;
+                }
+            }
+            std::shared_ptr<Node> node = key.create();
+            node->hash = hash;
+            shard.nodes.emplace(hash, Entry(node.get(), node));
+            return node;
+        }
+
+        void remove(const Node* node) {
+            Shard& shard = shardOf(node->hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto range = shard.nodes.equal_range(node->hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second.first == node) {
+                    shard.nodes.erase(it);
+                    return;
+                }
+            }
+        }
+
+    private:
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_multimap<std::size_t, Entry> nodes;
+        };
+
+        static constexpr std::size_t shardCount = 64;
+        std::array<Shard, shardCount> shards;
+
+        Shard& shardOf(std::size_t hash) {
+            return shards[(hash >> 7) % shardCount];
+        }
+    };
+};
+
+#endif // EXPRESSION_NODE_HPP
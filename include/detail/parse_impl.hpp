@@ -0,0 +1,45 @@
+#ifndef EXPRESSION_PARSE_IMPL_HPP
+#define EXPRESSION_PARSE_IMPL_HPP
+
+#include "expression.hpp"
+#include "node.hpp"
+#include "parser.hpp"
+
+// Разбор выражения из текста
+template <typename T>
+Expression<T> Expression<T>::parse(std::string_view text) {
+    // Узлы сразу создаются в общей таблице хэш-консинга
+    struct Builder {
+        using Value = std::shared_ptr<Node>;
+
+        static typename Node::Type type(parser::Op op) {
+            switch (op) {
+                case parser::Op::ADD: return Node::Type::ADD;
+                case parser::Op::SUBTRACT: return Node::Type::SUBTRACT;
+                case parser::Op::MULTIPLY: return Node::Type::MULTIPLY;
+                case parser::Op::DIVIDE: return Node::Type::DIVIDE;
+                case parser::Op::POWER: return Node::Type::POWER;
+                case parser::Op::SIN: return Node::Type::SIN;
+                case parser::Op::COS: return Node::Type::COS;
+                case parser::Op::EXP: return Node::Type::EXP;
+                case parser::Op::LOG: return Node::Type::LOG;
+                case parser::Op::NEGATE: return Node::Type::NEGATE;
+            }
+            return Node::Type::NEGATE;
+        }
+
+        Value constant(T value) { return Node::make(Node::Type::CONSTANT, value); }
+        Value variable(SymbolTable::Symbol symbol) {
+            return Node::make(Node::Type::VARIABLE, symbol);
+        }
+        Value binary(parser::Op op, const Value& a, const Value& b) {
+            return Node::make(type(op), a, b);
+        }
+        Value unary(parser::Op op, const Value& a) { return Node::make(type(op), a); }
+    };
+
+    Builder builder;
+    return Expression(parser::Parser<T, Builder>(text, builder).parse());
+}
+
+#endif // EXPRESSION_PARSE_IMPL_HPP
@@ -0,0 +1,290 @@
+#ifndef EXPRESSION_PARSER_HPP
+#define EXPRESSION_PARSER_HPP
+
+#include "expression_traits.hpp"
+#include "symbols.hpp"
+#include <charconv>
+#include <complex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Разбор текста выражения за один проход: разбор по приоритетам операций
+// на явных стеках операндов и операций, без рекурсии, поэтому вложенность
+// ограничена только памятью (как и у деревьев, которые печатает toString).
+//
+// Грамматика - та, что выдаёт toString(), плюс обычные приоритеты операций,
+// так что скобки вокруг каждой бинарной операции необязательны:
+//   expr    := term (('+' | '-') term)*
+//   term    := unary (('*' | '/') unary)*
+//   unary   := '-' unary | primary
+//   primary := число | '(' число ',' число ')' | имя | имя '(' expr ')'
+//            | 'pow' '(' expr ',' expr ')' | '(' expr ')'
+// '-' сразу перед числом - знак константы, как в выводе toString.
+// Лексемы - срезы исходной строки; узлы создаются через Builder сразу по
+// мере разбора, поэтому промежуточного дерева нет.
+namespace parser {
+
+enum class Op { ADD, SUBTRACT, MULTIPLY, DIVIDE, POWER, SIN, COS, EXP, LOG, NEGATE };
+
+// Builder: Value constant(T), Value variable(Symbol), Value binary(Op, a, b),
+// Value unary(Op, a)
+template <typename T, typename Builder>
+class Parser {
+public:
+    using Value = typename Builder::Value;
+
+    Parser(std::string_view text, Builder& builder) : text(text), builder(builder) {}
+
+    Value parse() {
+        bool operand = true;
+        for (;;) {
+            char c = peek();
+            if (operand) {
+                operand = !startOperand(c);
+                continue;
+            }
+            if (c == '\0') break;
+            int p = precedence(c);
+            if (p > 0) {
+                // Левая ассоциативность: сворачиваются операции не слабее новой
+                while (!operators.empty() && operators.back().precedence >= p) reduce();
+                operators.push_back({Entry::BINARY, binaryOp(c), p, false});
+                ++pos;
+                operand = true;
+            } else if (c == ',') {
+                Entry& call = enclosing();
+                if (call.kind != Entry::CALL || call.op != Op::POWER || call.comma)
+                    fail("unexpected ','");
+                call.comma = true;
+                ++pos;
+                operand = true;
+            } else if (c == ')') {
+                Entry entry = enclosing();
+                operators.pop_back();
+                if (entry.kind == Entry::CALL) {
+                    if ((entry.op == Op::POWER) != entry.comma)
+                        fail(entry.comma ? "unexpected ','" : "expected ','");
+                    if (entry.op == Op::POWER) {
+                        binary(entry.op);
+                    } else {
+                        unary(entry.op);
+                    }
+                }
+                ++pos;
+            } else {
+                fail("unexpected input");
+            }
+        }
+        while (!operators.empty()) {
+            if (operators.back().kind == Entry::GROUP || operators.back().kind == Entry::CALL)
+                fail("expected ')'");
+            reduce();
+        }
+        return std::move(operands.back());
+    }
+
+private:
+    // Элемент стека операций: бинарная операция, унарный минус, открывающая
+    // скобка группы или вызов функции
+    struct Entry {
+        enum Kind { BINARY, PREFIX, GROUP, CALL } kind;
+        Op op;
+        int precedence;
+        // Для pow: уже встретилась запятая между аргументами
+        bool comma;
+    };
+
+    static constexpr int prefixPrecedence = 3;
+
+    std::string_view text;
+    std::size_t pos = 0;
+    Builder& builder;
+    std::vector<Value> operands;
+    std::vector<Entry> operators;
+    // Имена, уже найденные в этом тексте: повторное имя не обращается к таблице символов
+    static constexpr std::size_t cachedNames = 16;
+    std::vector<std::pair<std::string_view, SymbolTable::Symbol>> names;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error("Parse error at " + std::to_string(pos) + ": " + message);
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' ||
+                                     text[pos] == '\n' || text[pos] == '\r'))
+            ++pos;
+    }
+
+    char peek() {
+        skipSpace();
+        return pos < text.size() ? text[pos] : '\0';
+    }
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    static bool isIdentifierStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static bool isIdentifier(char c) { return isIdentifierStart(c) || isDigit(c); }
+
+    static int precedence(char c) {
+        switch (c) {
+            case '+': case '-': return 1;
+            case '*': case '/': return 2;
+            default: return 0;
+        }
+    }
+
+    static Op binaryOp(char c) {
+        return c == '+' ? Op::ADD : c == '-' ? Op::SUBTRACT : c == '*' ? Op::MULTIPLY : Op::DIVIDE;
+    }
+
+    // Ближайшая незакрытая скобка; операции над ней сворачиваются
+    Entry& enclosing() {
+        while (!operators.empty() && (operators.back().kind == Entry::BINARY ||
+                                      operators.back().kind == Entry::PREFIX))
+            reduce();
+        if (operators.empty()) fail("unexpected '" + std::string(1, text[pos]) + "'");
+        return operators.back();
+    }
+
+    void reduce() {
+        Entry entry = operators.back();
+        operators.pop_back();
+        if (entry.kind == Entry::BINARY) {
+            binary(entry.op);
+        } else {
+            unary(entry.op);
+        }
+    }
+
+    void binary(Op op) {
+        Value rhs = std::move(operands.back());
+        operands.pop_back();
+        Value lhs = std::move(operands.back());
+        operands.pop_back();
+        operands.push_back(builder.binary(op, std::move(lhs), std::move(rhs)));
+    }
+
+    void unary(Op op) {
+        Value argument = std::move(operands.back());
+        operands.pop_back();
+        operands.push_back(builder.unary(op, std::move(argument)));
+    }
+
+    // Начало операнда. Возвращает true, если операнд закончен (константа или
+    // переменная), и false, если открыта скобка, вызов или унарный минус.
+    bool startOperand(char c) {
+        if (c == '-') {
+            std::size_t sign = pos++;
+            char next = pos < text.size() ? text[pos] : '\0';
+            if (isDigit(next) || next == '.' || startsSpecial()) {
+                pos = sign;
+                operands.push_back(builder.constant(T(real())));
+                return true;
+            }
+            operators.push_back({Entry::PREFIX, Op::NEGATE, prefixPrecedence, false});
+            return false;
+        }
+        if (isDigit(c) || c == '.') {
+            operands.push_back(builder.constant(T(real())));
+            return true;
+        }
+        if (c == '(') {
+            ++pos;
+            if constexpr (ScalarTraits<T>::isComplex) {
+                // Комплексная константа в записи operator<<: (re,im)
+                std::size_t start = pos;
+                double re;
+                if (tryReal(re) && peek() == ',') {
+                    ++pos;
+                    double im = real();
+                    if (peek() != ')') fail("expected ')'");
+                    ++pos;
+                    operands.push_back(builder.constant(T(re, im)));
+                    return true;
+                }
+                pos = start;
+            }
+            operators.push_back({Entry::GROUP, Op::ADD, 0, false});
+            return false;
+        }
+        if (!isIdentifierStart(c)) fail("expected expression");
+
+        std::size_t start = pos;
+        while (pos < text.size() && isIdentifier(text[pos])) ++pos;
+        std::string_view name = text.substr(start, pos - start);
+        if (name == "inf" || name == "nan") {
+            pos = start;
+            operands.push_back(builder.constant(T(real())));
+            return true;
+        }
+        if (peek() != '(') {
+            operands.push_back(builder.variable(symbol(name)));
+            return true;
+        }
+
+        Op op;
+        if (name == "pow") op = Op::POWER;
+        else if (name == "sin") op = Op::SIN;
+        else if (name == "cos") op = Op::COS;
+        else if (name == "exp") op = Op::EXP;
+        else if (name == "log") op = Op::LOG;
+        else {
+            pos = start;
+            fail("unknown function");
+        }
+        ++pos;
+        operators.push_back({Entry::CALL, op, 0, false});
+        return false;
+    }
+
+    // inf и nan в выводе потока (в том числе со знаком)
+    bool startsSpecial() const {
+        std::string_view rest = text.substr(pos);
+        for (std::string_view word : {std::string_view("inf"), std::string_view("nan")}) {
+            if (rest.substr(0, 3) == word && (rest.size() == 3 || !isIdentifier(rest[3])))
+                return true;
+        }
+        return false;
+    }
+
+    bool tryReal(double& value) {
+        skipSpace();
+        std::size_t start = pos;
+        if (pos < text.size() && text[pos] == '-') ++pos;
+        char c = pos < text.size() ? text[pos] : '\0';
+        bool numeric = isDigit(c) || c == '.' || startsSpecial();
+        pos = start;
+        if (!numeric) return false;
+        auto [end, error] = std::from_chars(text.data() + pos, text.data() + text.size(), value);
+        if (error == std::errc::result_out_of_range) fail("number out of range");
+        if (error != std::errc()) return false;
+        pos = static_cast<std::size_t>(end - text.data());
+        return true;
+    }
+
+    double real() {
+        double value;
+        if (!tryReal(value)) fail("expected number");
+        return value;
+    }
+
+    SymbolTable::Symbol symbol(std::string_view name) {
+        for (const auto& [known, id] : names) {
+            if (known == name) return id;
+        }
+        SymbolTable::Symbol id = SymbolTable::intern(std::string(name));
+        if (names.size() < cachedNames) names.emplace_back(name, id);
+        return id;
+    }
+};
+
+} // namespace parser
+
+#endif // EXPRESSION_PARSER_HPP
@@ -0,0 +1,104 @@
+#ifndef EXPRESSION_POWER_HPP
+#define EXPRESSION_POWER_HPP
+
+#include "expression_traits.hpp"
+#include <cmath>
+#include <complex>
+#include <cstdint>
+
+// Степень с постоянным показателем.
+//
+// Производные порождают в основном pow(v, 2) и pow(u, n - 1) с небольшим
+// целым n, а std::pow для них - exp(y * log x) с проверками. Для постоянного
+// показателя 2 берётся квадрат, для -1 - обратная величина, для 0.5 -
+// sqrt, для прочих целых |n| <= maxInteger - двоичное возведение в степень
+// (для отрицательных n - обратная величина от него). Дерево, программа,
+// пакетные ядра, JIT, арена и образ выбирают путь по показателю одинаково,
+// поэтому их результаты совпадают. От std::pow результат отличается на несколько ulp
+// для больших n, а sqrt - знаком у -0 и значением NaN вместо +inf у -inf.
+namespace power {
+
+enum class Kind : std::uint8_t { GENERAL, SQUARE, RECIPROCAL, SQRT, INTEGER };
+
+constexpr int maxInteger = 64;
+
+// n - показатель для INTEGER
+inline Kind classify(double exponent, int& n) {
+    n = 0;
+    if (exponent == 2.0) return Kind::SQUARE;
+    if (exponent == -1.0) return Kind::RECIPROCAL;
+    if (exponent == 0.5) return Kind::SQRT;
+    if (exponent >= -maxInteger && exponent <= maxInteger && exponent == std::trunc(exponent)) {
+        n = static_cast<int>(exponent);
+        return Kind::INTEGER;
+    }
+    return Kind::GENERAL;
+}
+
+// Показатель другого типа - через его действительное значение, если оно есть
+template <typename V>
+Kind classify(const V& exponent, int& n) {
+    n = 0;
+    double value;
+    if (!ScalarTraits<V>::real(exponent, value)) return Kind::GENERAL;
+    return classify(value, n);
+}
+
+template <typename V>
+V square(const V& x) {
+    return x * x;
+}
+
+// Без общего умножения std::complex с его разбором бесконечностей; тот
+// нужен, только если прямая формула дала неконечный результат
+inline std::complex<double> square(const std::complex<double>& z) {
+    double a = z.real(), b = z.imag();
+    double re = a * a - b * b;
+    double im = 2.0 * a * b;
+    if (std::isfinite(re) && std::isfinite(im)) return {re, im};
+    return z * z;
+}
+
+// x^n умножениями: множители идут от младших битов n к старшим
+template <typename V>
+V integer(const V& x, int n) {
+    unsigned k = n < 0 ? 0u - static_cast<unsigned>(n) : static_cast<unsigned>(n);
+    if (k == 0) return V(1);
+    V base = x;
+    V result = x;
+    bool first = true;
+    while (true) {
+        if (k & 1) {
+            result = first ? base : result * base;
+            first = false;
+        }
+        k >>= 1;
+        if (!k) break;
+        base = square(base);
+    }
+    return n < 0 ? V(1) / result : result;
+}
+
+template <typename V>
+V apply(Kind kind, const V& x, int n, const V& exponent) {
+    switch (kind) {
+        case Kind::SQUARE: return square(x);
+        case Kind::RECIPROCAL: return V(1) / x;
+        case Kind::SQRT: return scalar::sqrt(x);
+        case Kind::INTEGER: return integer(x, n);
+        case Kind::GENERAL: break;
+    }
+    return scalar::pow(x, exponent);
+}
+
+// Степень, показатель которой - узел CONSTANT
+template <typename V>
+V constant(const V& x, const V& exponent) {
+    int n;
+    Kind kind = classify(exponent, n);
+    return apply(kind, x, n, exponent);
+}
+
+} // namespace power
+
+#endif // EXPRESSION_POWER_HPP
@@ -0,0 +1,336 @@
+#ifndef EXPRESSION_SIMPLIFY_IMPL_HPP
+#define EXPRESSION_SIMPLIFY_IMPL_HPP
+
+#include "expression.hpp"
+#include "node.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+// Упрощение выражений
+template <typename T>
+struct Expression<T>::Simplifier {
+    using Type = typename Node::Type;
+    using Term = std::pair<std::shared_ptr<Node>, T>;
+
+    std::unordered_map<const Node*, std::shared_ptr<Node>> done;
+
+    static std::shared_ptr<Node> constant(T value) {
+        return Node::make(Type::CONSTANT, value);
+    }
+
+    static bool isConstant(const std::shared_ptr<Node>& node, T value) {
+        return node->type == Type::CONSTANT && node->value == value;
+    }
+
+    static bool isAdditive(Type type) {
+        return type == Type::ADD || type == Type::SUBTRACT || type == Type::NEGATE;
+    }
+
+    // Результат для узла, если он уже готов; иначе узел кладётся в стек
+    // и возвращается nullptr
+    const std::shared_ptr<Node>* need(const std::shared_ptr<Node>& node,
+                                      std::vector<std::shared_ptr<Node>>& stack) const {
+        auto it = done.find(node.get());
+        if (it != done.end()) return &it->second;
+        stack.push_back(node);
+        return nullptr;
+    }
+
+    // Один проход снизу вверх; общие подграфы упрощаются один раз.
+    // Явный стек вместо рекурсии: узел обрабатывается заново, пока правила
+    // для него просят ещё не упрощённые узлы, и снимается, когда все готовы
+    std::shared_ptr<Node> run(const std::shared_ptr<Node>& root) {
+        std::vector<std::shared_ptr<Node>> stack{root};
+        while (!stack.empty()) {
+            std::shared_ptr<Node> node = stack.back();
+            if (done.count(node.get())) {
+                stack.pop_back();
+                continue;
+            }
+            std::size_t depth = stack.size();
+            std::shared_ptr<Node> result = visit(node, stack);
+            if (stack.size() != depth) continue;
+            stack.pop_back();
+            done.emplace(node.get(), std::move(result));
+        }
+        return done.at(root.get());
+    }
+
+    // Упрощение узла; если каких-то результатов ещё нет, они добавляются в
+    // стек, а возвращённое значение не используется
+    std::shared_ptr<Node> visit(const std::shared_ptr<Node>& node,
+                                std::vector<std::shared_ptr<Node>>& stack) {
+        if (isAdditive(node->type) || node->type == Type::SUM) return simplifySum(node, stack);
+        if (node->type == Type::MULTIPLY || node->type == Type::PRODUCT)
+            return simplifyProduct(node, stack);
+        if (node->terms) {
+            // Порядок компенсированной суммы не меняется: упрощаются только слагаемые
+            std::vector<std::shared_ptr<Node>> terms;
+            terms.reserve(node->terms->size());
+            bool ready = true;
+            for (const std::shared_ptr<Node>& term : *node->terms) {
+                const std::shared_ptr<Node>* simplified = need(term, stack);
+                if (simplified) terms.push_back(*simplified);
+                ready = ready && simplified;
+            }
+            if (!ready) return nullptr;
+            return terms == *node->terms ? node : Node::make(node->type, std::move(terms));
+        }
+        if (node->left) {
+            const std::shared_ptr<Node>* left = need(node->left, stack);
+            const std::shared_ptr<Node>* right = node->right ? need(node->right, stack) : nullptr;
+            if (!left || (node->right && !right)) return nullptr;
+            return rewrite(node, *left, right ? *right : nullptr);
+        }
+        return node;
+    }
+
+    // Сумма раскладывается в список (слагаемое, коэффициент) и константу.
+    // Узлы разделяются хэш-консингом, поэтому подобные слагаемые - это один узел.
+    // Явный стек вместо рекурсии: длинные суммы бывают очень глубокими.
+    // nary отмечает, что среди слагаемых встретился узел SUM. Неупрощённые
+    // слагаемые пропускаются и остаются в work для run.
+    void collect(const std::shared_ptr<Node>& root, T rootSign, std::vector<Term>& terms,
+                 std::unordered_map<const Node*, std::size_t>& index, T& sum, bool& nary,
+                 std::vector<std::shared_ptr<Node>>& work) {
+        std::vector<std::pair<std::shared_ptr<Node>, T>> stack{{root, rootSign}};
+        while (!stack.empty()) {
+            auto [node, sign] = std::move(stack.back());
+            stack.pop_back();
+            // Правое слагаемое кладётся первым, чтобы порядок сохранился
+            switch (node->type) {
+                case Type::ADD:
+                    stack.emplace_back(node->right, sign);
+                    stack.emplace_back(node->left, sign);
+                    continue;
+                case Type::SUBTRACT:
+                    stack.emplace_back(node->right, -sign);
+                    stack.emplace_back(node->left, sign);
+                    continue;
+                case Type::NEGATE:
+                    stack.emplace_back(node->left, -sign);
+                    continue;
+                case Type::SUM:
+                    nary = true;
+                    for (std::size_t i = node->terms->size(); i-- > 0;)
+                        stack.emplace_back((*node->terms)[i], sign);
+                    continue;
+                default:
+                    break;
+            }
+            const std::shared_ptr<Node>* simplified = need(node, work);
+            if (!simplified) continue;
+            auto term = *simplified;
+            T coefficient = sign;
+            if (isAdditive(term->type) || term->type == Type::SUM) {
+                stack.emplace_back(term, sign);
+                continue;
+            }
+            if (term->type == Type::CONSTANT) {
+                sum += sign * term->value;
+                continue;
+            }
+            if (term->type == Type::MULTIPLY && term->left->type == Type::CONSTANT) {
+                coefficient = sign * term->left->value;
+                term = term->right;
+            }
+            // Приведение подобных слагаемых
+            auto [it, inserted] = index.emplace(term.get(), terms.size());
+            if (inserted) {
+                terms.emplace_back(term, coefficient);
+            } else {
+                terms[it->second].second += coefficient;
+            }
+        }
+    }
+
+    std::shared_ptr<Node> simplifySum(const std::shared_ptr<Node>& node,
+                                      std::vector<std::shared_ptr<Node>>& work) {
+        std::vector<Term> terms;
+        std::unordered_map<const Node*, std::size_t> index;
+        T sum = T(0);
+        bool nary = false;
+        std::size_t depth = work.size();
+        collect(node, T(1), terms, index, sum, nary, work);
+        if (work.size() != depth) return nullptr;
+
+        std::vector<Term> kept;
+        for (auto& term : terms) {
+            if (term.second != T(0)) kept.push_back(std::move(term));
+        }
+        // Первым ставится слагаемое с положительным коэффициентом, чтобы
+        // сумма не начиналась с отрицания
+        for (std::size_t i = 0; i < kept.size(); ++i) {
+            if (!ScalarTraits<T>::negative(kept[i].second)) {
+                std::rotate(kept.begin(), kept.begin() + i, kept.begin() + i + 1);
+                break;
+            }
+        }
+
+        if (nary) {
+            // Сумма с узлом SUM остаётся n-арной
+            std::vector<std::shared_ptr<Node>> parts;
+            parts.reserve(kept.size() + 1);
+            for (const auto& [term, coefficient] : kept) {
+                bool negative = ScalarTraits<T>::negative(coefficient);
+                T magnitude = negative ? -coefficient : coefficient;
+                auto scaled = magnitude == T(1) ? term
+                    : Node::make(Type::MULTIPLY, constant(magnitude), term);
+                parts.push_back(negative ? negate(scaled) : scaled);
+            }
+            if (sum != T(0)) parts.push_back(constant(sum));
+            return Node::nary(Type::SUM, std::move(parts), T(0));
+        }
+
+        std::shared_ptr<Node> result;
+        for (const auto& [term, coefficient] : kept) {
+            bool negative = ScalarTraits<T>::negative(coefficient);
+            T magnitude = negative ? -coefficient : coefficient;
+            auto scaled = magnitude == T(1) ? term
+                : Node::make(Type::MULTIPLY, constant(magnitude), term);
+            if (!result) {
+                result = negative ? negate(scaled) : scaled;
+            } else {
+                result = Node::make(negative ? Type::SUBTRACT : Type::ADD, result, scaled);
+            }
+        }
+        if (!result) return constant(sum);
+        if (sum != T(0)) {
+            bool negative = ScalarTraits<T>::negative(sum);
+            result = Node::make(negative ? Type::SUBTRACT : Type::ADD, result,
+                                       constant(negative ? -sum : sum));
+        }
+        return result;
+    }
+
+    static std::shared_ptr<Node> negate(const std::shared_ptr<Node>& node) {
+        if (node->type == Type::MULTIPLY && node->left->type == Type::CONSTANT) {
+            return Node::make(Type::MULTIPLY, constant(-node->left->value), node->right);
+        }
+        return Node::make(Type::NEGATE, node);
+    }
+
+    // Произведение раскладывается в список множителей и числовой коэффициент
+    void collectFactors(const std::shared_ptr<Node>& root,
+                        std::vector<std::shared_ptr<Node>>& factors, T& k, bool& nary,
+                        std::vector<std::shared_ptr<Node>>& work) {
+        std::vector<std::shared_ptr<Node>> stack{root};
+        while (!stack.empty()) {
+            std::shared_ptr<Node> node = std::move(stack.back());
+            stack.pop_back();
+            if (node->type == Type::MULTIPLY) {
+                stack.push_back(node->right);
+                stack.push_back(node->left);
+                continue;
+            }
+            if (node->type == Type::PRODUCT) {
+                nary = true;
+                for (std::size_t i = node->terms->size(); i-- > 0;)
+                    stack.push_back((*node->terms)[i]);
+                continue;
+            }
+            const std::shared_ptr<Node>* simplified = need(node, work);
+            if (!simplified) continue;
+            const std::shared_ptr<Node>& factor = *simplified;
+            if (factor->type == Type::CONSTANT) {
+                k *= factor->value;
+            } else if (factor->type == Type::NEGATE) {
+                k = -k;
+                stack.push_back(factor->left);
+            } else if (factor->type == Type::MULTIPLY || factor->type == Type::PRODUCT) {
+                stack.push_back(factor);
+            } else {
+                factors.push_back(factor);
+            }
+        }
+    }
+
+    std::shared_ptr<Node> simplifyProduct(const std::shared_ptr<Node>& node,
+                                          std::vector<std::shared_ptr<Node>>& work) {
+        std::vector<std::shared_ptr<Node>> factors;
+        T k = T(1);
+        bool nary = false;
+        std::size_t depth = work.size();
+        collectFactors(node, factors, k, nary, work);
+        if (work.size() != depth) return nullptr;
+        if (k == T(0) || factors.empty()) return constant(k);
+
+        std::shared_ptr<Node> product;
+        if (nary) {
+            product = Node::nary(Type::PRODUCT, std::move(factors), T(1));
+        } else {
+            product = factors.front();
+            for (std::size_t i = 1; i < factors.size(); ++i) {
+                product = Node::make(Type::MULTIPLY, product, factors[i]);
+            }
+        }
+        if (k == T(1)) return product;
+        if (k == T(-1)) return Node::make(Type::NEGATE, product);
+        return Node::make(Type::MULTIPLY, constant(k), product);
+    }
+
+    // Локальные правила для узла с уже упрощёнными потомками
+    std::shared_ptr<Node> rewrite(const std::shared_ptr<Node>& node,
+                                  const std::shared_ptr<Node>& left,
+                                  const std::shared_ptr<Node>& right) {
+        bool foldable = left->type == Type::CONSTANT &&
+                        (!right || right->type == Type::CONSTANT);
+        auto rebuilt = (left == node->left && right == node->right) ? node
+            : (right ? Node::make(node->type, left, right)
+                     : Node::make(node->type, left));
+        if (foldable) return constant(Expression(rebuilt).evaluate());
+
+        switch (node->type) {
+            case Type::DIVIDE:
+                if (isConstant(right, T(1))) return left;
+                if (isConstant(left, T(0))) return left;
+                if (left == right) return constant(T(1));
+                if (left->type == Type::NEGATE && right->type == Type::NEGATE)
+                    return Node::make(Type::DIVIDE, left->left, right->left);
+                if (left->type == Type::NEGATE)
+                    return negate(Node::make(Type::DIVIDE, left->left, right));
+                if (right->type == Type::NEGATE)
+                    return negate(Node::make(Type::DIVIDE, left, right->left));
+                break;
+            case Type::POWER:
+                if (isConstant(right, T(1))) return left;
+                if (isConstant(right, T(0)) || isConstant(left, T(1))) return constant(T(1));
+                break;
+            case Type::SIN:
+                if (left->type == Type::NEGATE)
+                    return negate(Node::make(Type::SIN, left->left));
+                break;
+            case Type::COS:
+                if (left->type == Type::NEGATE)
+                    return Node::make(Type::COS, left->left);
+                break;
+            default:
+                break;
+        }
+        return rebuilt;
+    }
+};
+
+template <typename T>
+std::shared_ptr<typename Expression<T>::Node> Expression<T>::simplify(
+    const std::shared_ptr<Node>& node) {
+    // Каждый проход может открыть новые возможности для правил выше по дереву
+    constexpr int maxPasses = 16;
+    std::shared_ptr<Node> current = node;
+    for (int pass = 0; pass < maxPasses; ++pass) {
+        Simplifier simplifier;
+        auto next = simplifier.run(current);
+        if (next == current) return next;
+        current = next;
+    }
+    return current;
+}
+
+template <typename T>
+Expression<T> Expression<T>::simplify() const {
+    CounterScope scope(ExpressionCounters::Operation::SIMPLIFY);
+    return Expression(simplify(root));
+}
+
+#endif // EXPRESSION_SIMPLIFY_IMPL_HPP
@@ -0,0 +1,47 @@
+#ifndef EXPRESSION_STATS_IMPL_HPP
+#define EXPRESSION_STATS_IMPL_HPP
+
+#include "expression.hpp"
+#include "node.hpp"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+// Статистика выражения
+template <typename T>
+ExpressionStats Expression<T>::stats() const {
+    // Блок make_shared: узел, указатель на таблицу виртуальных функций и два счётчика
+    constexpr std::size_t nodeBytes = sizeof(Node) + 2 * sizeof(void*) + Node::Table::entryBytes;
+    // Имена в порядке Node::Type
+    static const char* const typeNames[] = {
+        "CONSTANT", "VARIABLE", "ADD", "SUBTRACT", "MULTIPLY", "DIVIDE", "POWER", "SIN", "COS",
+        "EXP", "LOG", "NEGATE", "SUM", "COMPENSATED_SUM", "PRODUCT"
+    };
+    ExpressionStats stats;
+    std::size_t counts[std::size(typeNames)] = {};
+    // Размер развёрнутого дерева считается заново в 64 битах: Node::size
+    // насыщается на UINT32_MAX
+    using Count = std::uint64_t;
+    Count tree = Node::template fold<Count>(root.get(), [&](const Node* node, const Count* l,
+                                                            const Count*) -> Count {
+        ++stats.uniqueNodes;
+        ++counts[static_cast<std::size_t>(node->type)];
+        stats.bytes += nodeBytes;
+        if (node->terms)
+            stats.bytes += sizeof(*node->terms) +
+                           node->terms->capacity() * sizeof(std::shared_ptr<Node>);
+        Count result = 1;
+        // Результаты потомков лежат подряд и у бинарных, и у n-арных узлов
+        for (std::size_t i = 0, n = node->arity(); i < n; ++i)
+            result += std::min(l[i], std::numeric_limits<Count>::max() - result);
+        return result;
+    });
+    stats.treeNodes = tree;
+    stats.depth = root->depth;
+    for (std::size_t i = 0; i < std::size(typeNames); ++i) {
+        if (counts[i]) stats.types[typeNames[i]] = counts[i];
+    }
+    return stats;
+}
+
+#endif // EXPRESSION_STATS_IMPL_HPP
@@ -0,0 +1,24 @@
+#ifndef EXPRESSION_SYMBOLS_HPP
+#define EXPRESSION_SYMBOLS_HPP
+
+#include <cstdint>
+#include <string>
+
+// Общая таблица имён переменных: имя <-> небольшой целый номер.
+// Узлы хранят только номер, поэтому сравнение переменных - сравнение чисел.
+// Номера не переиспользуются, имена живут до конца программы.
+// Все функции потокобезопасны.
+class SymbolTable {
+public:
+    using Symbol = std::uint32_t;
+    static constexpr Symbol none = ~Symbol(0);
+
+    static Symbol intern(const std::string& name);
+    // none, если имя ещё не встречалось
+    static Symbol find(const std::string& name);
+    // Ссылка остаётся действительной до конца программы. Без блокировки:
+    // вызывается для каждого листа VARIABLE при вычислении и печати
+    static const std::string& name(Symbol symbol);
+};
+
+#endif // EXPRESSION_SYMBOLS_HPP
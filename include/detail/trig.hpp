@@ -0,0 +1,54 @@
+#ifndef EXPRESSION_TRIG_HPP
+#define EXPRESSION_TRIG_HPP
+
+#include "expression_traits.hpp"
+#include <cfloat>
+#include <cmath>
+#include <complex>
+
+// Синус и косинус одного аргумента за одно вычисление.
+//
+// Производные тригонометрических выражений порождают пары sin(u) и cos(u)
+// с общим u; компиляция сливает такую пару в одну инструкцию SINCOS. Для
+// double это sincos из glibc (одна редукция аргумента), для complex - тот
+// же sincos действительной части и общие cosh, sinh мнимой. Формулы
+// повторяют csin и ccos из glibc, поэтому результат побитово совпадает с
+// std::sin и std::cos; вне диапазона, где glibc переходит на особые ветви,
+// значения берутся из std::sin и std::cos.
+namespace trig {
+
+// Аргумент передаётся по значению: s или c может быть той же ячейкой
+inline void sincos(double x, double& s, double& c) {
+#ifdef __GLIBC__
+    ::sincos(x, &s, &c);
+#else
+    s = std::sin(x);
+    c = std::cos(x);
+#endif
+}
+
+inline void sincos(std::complex<double> z, std::complex<double>& s, std::complex<double>& c) {
+    double a = z.real(), b = z.imag();
+    // 709 - порог переполнения cosh в csin и ccos
+    if (std::fabs(a) > DBL_MIN && std::fabs(a) <= DBL_MAX && std::fabs(b) <= 709.0) {
+        double sa, ca;
+        sincos(a, sa, ca);
+        double ch = std::cosh(b), sh = std::sinh(b);
+        s = {ch * sa, sh * ca};
+        c = {ch * ca, -(sh * sa)};
+        return;
+    }
+    s = std::sin(z);
+    c = std::cos(z);
+}
+
+// Прочие типы значений - двумя вызовами
+template <typename V>
+void sincos(V x, V& s, V& c) {
+    s = scalar::sin(x);
+    c = scalar::cos(x);
+}
+
+} // namespace trig
+
+#endif // EXPRESSION_TRIG_HPP
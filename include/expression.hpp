@@ -1,14 +1,130 @@
 #ifndef EXPRESSION_HPP
 #define EXPRESSION_HPP
 
+#include "expression_traits.hpp"
 #include <memory>
 #include <string>
+#include <string_view>
 #include <map>
 #include <complex>
 #include <cmath>
 #include <stdexcept>
 #include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
 
+template <typename T>
+class Expression;
+
+template <typename T>
+class CompiledExpression;
+
+template <typename T>
+class ExpressionArena;
+
+template <typename T>
+class JitExpression;
+
+template <typename T>
+class ExpressionImage;
+
+template <typename T>
+class IncrementalEvaluator;
+
+class IntervalExpression;
+
+class ThreadPool;
+
+// Значение выражения и его производная по направлению
+template <typename T>
+struct Dual {
+    T value;
+    T derivative;
+};
+
+// Расстановка скобок в toString: вокруг каждой бинарной операции или только там,
+// где их требуют приоритеты и левая ассоциативность
+enum class Parentheses : std::uint8_t { ALL, MINIMAL };
+
+// Порядок суммирования в Expression::sum: четыре независимых накопителя или
+// суммирование по Кахану с поправкой на ошибку округления (вчетверо больше операций)
+enum class Summation : std::uint8_t { FAST, COMPENSATED };
+
+// Сводка о форме выражения (Expression::stats)
+struct ExpressionStats {
+    // Узлов в дереве, в котором каждое вхождение общего подвыражения считается
+    // отдельно; насыщается на UINT64_MAX
+    std::uint64_t treeNodes = 0;
+    // Различных узлов: общие подвыражения хранятся один раз
+    std::size_t uniqueNodes = 0;
+    // Число узлов на самом длинном пути от корня до листа
+    std::size_t depth = 0;
+    // Различные узлы по типам: "CONSTANT", "VARIABLE", "ADD", ...
+    std::map<std::string, std::size_t> types;
+    // Оценка памяти под различные узлы: сами узлы с блоками shared_ptr,
+    // потомки n-арных узлов и записи таблицы хэш-консинга
+    std::size_t bytes = 0;
+};
+
+// Столбцы входных данных для пакетного вычисления: имя переменной -> массив значений
+template <typename T>
+class ColumnSet {
+public:
+    ColumnSet() = default;
+    ColumnSet(std::initializer_list<std::pair<const std::string, const T*>> columns)
+        : columns(columns) {}
+    
+    ColumnSet& add(const std::string& variable, const T* values) {
+        columns[variable] = values;
+        return *this;
+    }
+    
+    const T* find(const std::string& variable) const {
+        auto it = columns.find(variable);
+        return it != columns.end() ? it->second : nullptr;
+    }
+
+private:
+    std::map<std::string, const T*> columns;
+};
+
+// Кэш производных, который вызывающий хранит между вызовами derivative:
+// d(узел)/d(переменная) запоминается для каждого уникального узла, поэтому
+// общие поддеревья, в том числе у разных выражений, дифференцируются один
+// раз. Кэш удерживает свои узлы до clear() или разрушения контекста.
+// Контекст не потокобезопасен: для параллельной работы нужен свой на поток.
+template <typename T>
+class DerivativeContext {
+public:
+    DerivativeContext();
+    DerivativeContext(DerivativeContext&& other) noexcept;
+    DerivativeContext& operator=(DerivativeContext&& other) noexcept;
+    ~DerivativeContext();
+    
+    // Число запомненных пар (узел, переменная)
+    std::size_t size() const;
+    void clear();
+
+private:
+    friend class Expression<T>;
+    
+    struct Cache;
+    std::unique_ptr<Cache> cache;
+};
+
+// Потокобезопасность. Узлы неизменяемы после создания, поэтому константные
+// методы одного Expression и одного CompiledExpression можно вызывать из
+// любого числа потоков одновременно. Копирование и уничтожение Expression в
+// разных потоках меняет счётчики shared_ptr атомарно; таблица хэш-консинга и
+// таблица имён защищены блокировками, и узел, умирающий в одном потоке,
+// никогда не выдаётся другому. Обходы читают use_count() только как
+// подсказку для запоминания: гонка с копированием в другом потоке может
+// лишь сделать лишнюю или пропустить ненужную запись, но не меняет результат.
+// Присваивание одному и тому же объекту Expression из разных потоков, как и
+// для shared_ptr, требует внешней синхронизации.
 template <typename T>
 class Expression {
 public:
@@ -22,11 +138,32 @@ public:
     Expression& operator=(Expression&& other) noexcept = default;
     ~Expression() = default;
     
-    Expression operator+(const Expression& other) const;
-    Expression operator-(const Expression& other) const;
-    Expression operator*(const Expression& other) const;
-    Expression operator/(const Expression& other) const;
-    Expression operator-() const;
+    // Операнды принимаются по значению: временные выражения переносятся в
+    // новый узел, и счётчики ссылок их корней не трогаются
+    Expression operator+(Expression other) const&;
+    Expression operator+(Expression other) &&;
+    Expression operator-(Expression other) const&;
+    Expression operator-(Expression other) &&;
+    Expression operator*(Expression other) const&;
+    Expression operator*(Expression other) &&;
+    Expression operator/(Expression other) const&;
+    Expression operator/(Expression other) &&;
+    Expression operator-() const&;
+    Expression operator-() &&;
+    
+    // acc += term заменяет корень acc без копии: старый корень переносится
+    // в новый узел
+    Expression& operator+=(Expression other);
+    Expression& operator-=(Expression other);
+    Expression& operator*=(Expression other);
+    Expression& operator/=(Expression other);
+    
+    // Сумма и произведение одним n-арным узлом вместо цепочки бинарных
+    // операций; пустой набор даёт 0 и 1. Узел вычисляется несколькими
+    // независимыми накопителями, COMPENSATED - суммированием по Кахану.
+    static Expression sum(const std::vector<Expression>& terms,
+                          Summation summation = Summation::FAST);
+    static Expression product(const std::vector<Expression>& factors);
     
     static Expression sin(const Expression& expr);
     static Expression cos(const Expression& expr);
@@ -35,26 +172,224 @@ public:
     static Expression pow(const Expression& base, const Expression& exponent);
     
     T evaluate(const std::map<std::string, T>& variables = {}) const;
-    Expression derivative(const std::string& variable) const;
+    // При simplified = true результат проходит через simplify()
+    Expression derivative(const std::string& variable, bool simplified = false) const;
+    // То же с кэшем производных узлов между вызовами
+    Expression derivative(const std::string& variable, DerivativeContext<T>& context,
+                          bool simplified = false) const;
+    // Подстановка возвращает исходные узлы везде, где переменных нет, поэтому
+    // неизменённые поддеревья остаются общими с исходным выражением
     Expression substitute(const std::string& variable, const Expression& value) const;
+    // Одновременная подстановка нескольких переменных за один обход:
+    // подставленные выражения сами повторно не обрабатываются
+    Expression substitute(const std::map<std::string, Expression>& values) const;
+    // Свёртка констант, нейтральные и поглощающие элементы, приведение подобных
+    // слагаемых и лишних отрицаний; правила применяются до неподвижной точки
+    Expression simplify() const;
+    
+    CompiledExpression<T> compile() const;
+    // Связывает имена переменных с номерами слотов; неизвестная переменная - ошибка здесь,
+    // а не при вычислении
+    CompiledExpression<T> bind(const std::vector<std::string>& variables) const;
+    // Одна программа с несколькими выходами (CompiledExpression::evaluateAll):
+    // подвыражения, общие для выходов, вычисляются один раз
+    static CompiledExpression<T> compile(const std::vector<Expression>& outputs);
+    static CompiledExpression<T> bind(const std::vector<Expression>& outputs,
+                                      const std::vector<std::string>& variables);
+    void evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n) const;
+    void evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n, ThreadPool& pool,
+                       std::size_t threads = 0) const;
+    // Частные производные по variables в точке values за один прямой и один
+    // обратный проход; values должен задавать все переменные выражения
+    std::vector<T> gradient(const std::vector<std::string>& variables,
+                            const std::map<std::string, T>& values) const;
+    // Прямое дифференцирование дуальными числами за один обход, без построения
+    // дерева производной: значение и производная по variable
+    Dual<T> evaluateDual(const std::string& variable,
+                         const std::map<std::string, T>& values) const;
+    // Производная по направлению: direction[name] - приращение переменной name,
+    // отсутствующие в direction переменные считаются постоянными
+    Dual<T> evaluateDirectional(const std::map<std::string, T>& values,
+                                const std::map<std::string, T>& direction) const;
+    // Матрица Якоби functions по variables построчно: элемент [i * n + j] -
+    // d functions[i] / d variables[j]. Все элементы строятся через один
+    // DerivativeContext и делят общие подвыражения.
+    static std::vector<Expression> jacobian(const std::vector<Expression>& functions,
+                                            const std::vector<std::string>& variables,
+                                            bool simplified = true);
+    // Матрица Гессе построчно, n x n. Строится только верхний треугольник,
+    // элементы [j * n + i] и [i * n + j] - одно и то же выражение.
+    std::vector<Expression> hessian(const std::vector<std::string>& variables,
+                                    bool simplified = true) const;
+    
+    // Текст пишется в один буфер; константы печатаются через to_chars в том же
+    // виде, что и operator<< с точностью по умолчанию
+    std::string toString(Parentheses parentheses = Parentheses::ALL) const;
+    // То же прямо в поток, без полной промежуточной строки
+    void print(std::ostream& out, Parentheses parentheses = Parentheses::ALL) const;
+    // Разбор текста в грамматике toString(); приоритеты операций обычные,
+    // поэтому лишние скобки можно опускать. Ошибка - runtime_error с позицией.
+    static Expression parse(std::string_view text);
     
-    std::string toString() const;
+    // Двоичный образ (формат описан в expression_image.hpp). Общие
+    // подвыражения, в том числе между выражениями набора, пишутся один раз.
+    std::vector<unsigned char> serialize() const;
+    static std::vector<unsigned char> serialize(const std::vector<Expression>& expressions);
+    // Первое выражение образа; остальные доступны через ExpressionImage
+    static Expression deserialize(const void* data, std::size_t size);
+    
+    // Размеры и состав выражения за один обход различных узлов
+    ExpressionStats stats() const;
     
     bool isConstant() const;
     bool isVariable() const;
     bool isVariable(const std::string& var) const;
 
 private:
+    friend class ExpressionArena<T>;
+    friend class ExpressionImage<T>;
+    friend class DerivativeContext<T>;
+    friend class IncrementalEvaluator<T>;
+    
     struct Node;
+    struct Simplifier;
+    struct DualEvaluator;
+    struct Printer;
     std::shared_ptr<Node> root;
     
     explicit Expression(std::shared_ptr<Node> node);
     
+    // variable - номер имени в таблице символов
     static std::shared_ptr<Node> derivative(const std::shared_ptr<Node>& node, 
-                                          const std::string& variable);
+                                          std::uint32_t variable,
+                                          typename DerivativeContext<T>::Cache* cache = nullptr);
+    // values - пары (номер переменной, значение) по возрастанию номеров
+    static std::shared_ptr<Node> substitute(
+        const std::shared_ptr<Node>& node,
+        const std::vector<std::pair<std::uint32_t, std::shared_ptr<Node>>>& values);
     static std::shared_ptr<Node> simplify(const std::shared_ptr<Node>& node);
+    static std::vector<std::shared_ptr<Node>> roots(const std::vector<Expression>& items);
+    
+    CompiledExpression<T> compile(const std::vector<std::string>* binding) const;
+    static CompiledExpression<T> compile(const std::vector<Expression>& outputs,
+                                         const std::vector<std::string>* binding);
+};
+
+// Выражение, скомпилированное в плоскую программу для регистровой машины.
+// Инструкции идут в постфиксном порядке, каждый общий узел вычисляется один раз.
+template <typename T>
+class CompiledExpression {
+public:
+    enum class OpCode : std::uint8_t {
+        CONSTANT,
+        VARIABLE,
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        POWER,
+        SIN,
+        COS,
+        EXP,
+        LOG,
+        NEGATE,
+        // Степени с постоянным показателем: x^2, x^-1, x^0.5 и x^n для целого n
+        SQUARE,
+        RECIPROCAL,
+        SQRT,
+        POWI,
+        // sin и cos одного аргумента: sin пишется в dst, cos - в регистр rhs
+        SINCOS,
+        // Поправка суммы по Кахану: неконечное значение заменяется нулём
+        COMPENSATION
+    };
+    
+    // Для CONSTANT lhs - индекс в таблице констант, для VARIABLE - номер слота,
+    // для остальных операций lhs и rhs - номера регистров операндов; у POWI
+    // rhs - показатель n (int32_t в дополнительном коде), у SINCOS - второй
+    // регистр результата.
+    struct Instruction {
+        OpCode op;
+        std::uint32_t dst;
+        std::uint32_t lhs;
+        std::uint32_t rhs;
+    };
+    
+    static constexpr std::size_t inlineRegisters = 32;
+    
+    T evaluate(const std::map<std::string, T>& variables = {}) const;
+    // values[i] - значение переменной variables()[i]
+    T evaluate(const T* values) const;
+    T evaluate(const std::vector<T>& values) const;
+    // registers должен вмещать registerCount() элементов
+    T evaluate(const T* values, T* registers) const;
+    
+    // Все выходы программы, собранной из набора выражений, за один проход:
+    // out[k] - значение k-го выражения. Остальные методы вычисляют первый выход.
+    std::vector<T> evaluateAll(const std::map<std::string, T>& variables) const;
+    // out должен вмещать outputCount() элементов
+    void evaluateAll(const T* values, T* out) const;
+    void evaluateAll(const T* values, T* out, T* registers) const;
+    std::size_t outputCount() const { return outputs.size(); }
+    
+    // Вычисление по n строкам блоками: каждая инструкция обрабатывает блок
+    // векторным ядром. Для complex<double> блоки хранятся как раздельные
+    // массивы действительных и мнимых частей.
+    void evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n) const;
+    // То же в нескольких потоках (threads = 0 - во всех потоках пула). Строки
+    // делятся на фрагменты из целого числа блоков, каждый поток пишет только
+    // свои строки out, и результат побитово совпадает с однопоточным.
+    void evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n, ThreadPool& pool,
+                       std::size_t threads = 0) const;
+    // На общем пуле ThreadPool::shared()
+    void evaluateBatch(const ColumnSet<T>& inputs, T* out, std::size_t n,
+                       std::size_t threads) const;
+    // Все выходы по n строкам: outs[k] - массив из n значений k-го выхода
+    void evaluateBatchAll(const ColumnSet<T>& inputs, T* const* outs, std::size_t n) const;
+    void evaluateBatchAll(const ColumnSet<T>& inputs, T* const* outs, std::size_t n,
+                          ThreadPool& pool, std::size_t threads = 0) const;
+    
+    static constexpr std::size_t batchBlock = 256;
+    
+    // Обратное дифференцирование: gradient[i] = df/d variables()[i],
+    // возвращается значение выражения
+    T gradient(const T* values, T* gradient) const;
+    std::vector<T> gradient(const std::map<std::string, T>& variables) const;
+    // Прямое дифференцирование: tangents[i] - приращение переменной variables()[i]
+    Dual<T> evaluateDual(const T* values, const T* tangents) const;
+    // registers должен вмещать registerCount() элементов
+    Dual<T> evaluateDual(const T* values, const T* tangents, Dual<T>* registers) const;
+    
+    const std::vector<std::string>& variables() const { return slots; }
+    const std::vector<Instruction>& instructions() const { return program; }
+    std::size_t registerCount() const { return registers; }
+
+private:
+    friend class Expression<T>;
+    friend class JitExpression<T>;
+    friend class IntervalExpression;
+    
+    std::vector<Instruction> program;
+    std::vector<T> constants;
+    std::vector<std::string> slots;
+    std::uint32_t registers = 0;
+    std::uint32_t result = 0;
+    // Регистры выходов; result - первый из них
+    std::vector<std::uint32_t> outputs;
+    
+    CompiledExpression() = default;
+    
+    // Пакет по выбранным регистрам; pool == nullptr - в вызывающем потоке
+    void runBatch(const ColumnSet<T>& inputs, const std::vector<std::uint32_t>& registersOut,
+                  T* const* outs, std::size_t n, ThreadPool* pool, std::size_t threads) const;
 };
 
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const Expression<T>& expr) {
+    expr.print(out);
+    return out;
+}
+
 template <typename T>
 Expression<T> sin(const Expression<T>& expr) {
     return Expression<T>::sin(expr);
@@ -0,0 +1,99 @@
+#ifndef EXPRESSION_ARENA_HPP
+#define EXPRESSION_ARENA_HPP
+
+#include "expression.hpp"
+
+// Арена узлов для построения и отбрасывания большого числа выражений.
+//
+// Узел занимает 12 байт: тип и два 32-битных индекса. У CONSTANT left - индекс
+// в таблице констант, у VARIABLE - номер имени в общей таблице символов (той же,
+// что у Expression), у операций - номера узлов-операндов. Узлы хэш-консятся
+// внутри арены, и потомок всегда создан раньше родителя, поэтому все обходы -
+// проходы по массиву без рекурсии.
+// Отдельные узлы не освобождаются: память возвращается целиком через clear()
+// или вместе с ареной, до этого все Id остаются действительными.
+// Арена не потокобезопасна; для параллельной работы нужна своя арена на поток.
+template <typename T>
+class ExpressionArena {
+public:
+    using Id = std::uint32_t;
+
+    enum class Type : std::uint8_t {
+        CONSTANT,
+        VARIABLE,
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        POWER,
+        SIN,
+        COS,
+        EXP,
+        LOG,
+        NEGATE
+    };
+
+    struct Node {
+        Type type;
+        Id left;
+        Id right;
+    };
+
+    Id constant(T value);
+    Id variable(const std::string& name);
+
+    Id add(Id lhs, Id rhs) { return make(Type::ADD, lhs, rhs); }
+    Id subtract(Id lhs, Id rhs) { return make(Type::SUBTRACT, lhs, rhs); }
+    Id multiply(Id lhs, Id rhs) { return make(Type::MULTIPLY, lhs, rhs); }
+    Id divide(Id lhs, Id rhs) { return make(Type::DIVIDE, lhs, rhs); }
+    Id pow(Id base, Id exponent) { return make(Type::POWER, base, exponent); }
+    Id negate(Id node) { return make(Type::NEGATE, node); }
+    Id sin(Id node) { return make(Type::SIN, node); }
+    Id cos(Id node) { return make(Type::COS, node); }
+    Id exp(Id node) { return make(Type::EXP, node); }
+    Id log(Id node) { return make(Type::LOG, node); }
+
+    // Те же правила, что у Expression: результат структурно совпадает с
+    // Expression::evaluate/derivative/substitute для перенесённого выражения
+    T evaluate(Id node, const std::map<std::string, T>& variables = {}) const;
+    Id derivative(Id node, const std::string& variable);
+    Id substitute(Id node, const std::string& variable, Id value);
+    bool isConstant(Id node) const;
+
+    // Разбор текста в грамматике Expression::parse прямо в арену
+    Id parse(std::string_view text);
+
+    // Перенос между ареной и обычными выражениями. n-арные узлы (SUM,
+    // PRODUCT) раскладываются в бинарные операции в порядке их вычисления.
+    // У COMPENSATED_SUM поправка Кахана не обнуляется при неконечном
+    // слагаемом: в арене нет такой операции, и сумма с inf даёт NaN
+    Id import(const Expression<T>& expr);
+    Expression<T> toExpression(Id node) const;
+
+    const Node& node(Id id) const { return nodes[id]; }
+    const T& value(Id id) const { return constants[nodes[id].left]; }
+    const std::string& name(Id id) const;
+
+    std::size_t size() const { return nodes.size(); }
+    void reserve(std::size_t count);
+    // Освобождает все узлы сразу; ранее выданные Id становятся недействительными
+    void clear();
+
+private:
+    static constexpr Id none = ~Id(0);
+
+    std::vector<Node> nodes;
+    std::vector<T> constants;
+    // Открытая адресация с линейным пробированием: номера узлов или none
+    std::vector<Id> table;
+
+    Id make(Type type, Id left, Id right = none);
+    std::size_t hashOf(const Node& node) const;
+    bool equal(const Node& a, const Node& b) const;
+    Id intern(const Node& node, std::size_t hash);
+    void rehash(std::size_t capacity);
+    // Отметки узлов, достижимых из node (индексы 0..node)
+    std::vector<bool> reachable(Id node) const;
+};
+
+#endif // EXPRESSION_ARENA_HPP
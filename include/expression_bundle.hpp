@@ -0,0 +1,42 @@
+#ifndef EXPRESSION_BUNDLE_HPP
+#define EXPRESSION_BUNDLE_HPP
+
+#include "expression.hpp"
+
+// Набор выражений, которые вычисляются вместе на одних и тех же входах,
+// например f и несколько её производных.
+//
+// Выражения сливаются в один DAG и компилируются в одну программу с N
+// выходами: узел, общий для нескольких выражений (производные ссылаются на
+// поддеревья исходного выражения), вычисляется один раз за вычисление.
+// После построения набор неизменяем, и его константные методы можно
+// вызывать из нескольких потоков.
+template <typename T>
+class ExpressionBundle {
+public:
+    // Слоты переменных - в порядке первого появления
+    explicit ExpressionBundle(std::vector<Expression<T>> expressions);
+    // Слоты переменных заданы явно; переменная вне списка - runtime_error
+    ExpressionBundle(std::vector<Expression<T>> expressions,
+                     const std::vector<std::string>& variables);
+
+    std::size_t size() const { return expressions.size(); }
+    const Expression<T>& operator[](std::size_t index) const { return expressions[index]; }
+    const std::vector<std::string>& variables() const { return compiled.variables(); }
+    const CompiledExpression<T>& program() const { return compiled; }
+
+    // out[k] - значение k-го выражения; values[i] - значение variables()[i]
+    std::vector<T> evaluate(const std::map<std::string, T>& variables) const;
+    void evaluate(const T* values, T* out) const;
+
+    // outs[k] - массив из n значений k-го выражения
+    void evaluateBatch(const ColumnSet<T>& inputs, T* const* outs, std::size_t n) const;
+    void evaluateBatch(const ColumnSet<T>& inputs, T* const* outs, std::size_t n,
+                       ThreadPool& pool, std::size_t threads = 0) const;
+
+private:
+    std::vector<Expression<T>> expressions;
+    CompiledExpression<T> compiled;
+};
+
+#endif // EXPRESSION_BUNDLE_HPP
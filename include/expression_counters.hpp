@@ -0,0 +1,48 @@
+#ifndef EXPRESSION_COUNTERS_HPP
+#define EXPRESSION_COUNTERS_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Счётчики вызовов основных операций библиотеки для мониторинга.
+//
+// Собираются, только если библиотека построена с -DEXPRESSION_COUNTERS
+// (make COUNTERS=1); макрос нужен только при сборке библиотеки, программе
+// пользователя его задавать не надо. В обычной сборке замер - одна проверка
+// флага, enabled() возвращает false, а все значения нулевые. Для каждой операции
+// считаются вызовы, суммарное время и число новых узлов, созданных за время
+// вызова (узлы, найденные хэш-консингом, памяти не выделяют и не считаются).
+// Вложенный вызов учитывается и в своей операции, и во внешней: derivative
+// с simplified = true включает время упрощения.
+// Счётчики глобальные и атомарные; все функции потокобезопасны.
+class ExpressionCounters {
+public:
+    enum class Operation : std::uint8_t {
+        EVALUATE,
+        COMPILED_EVALUATE,
+        BATCH,
+        DERIVATIVE,
+        SUBSTITUTE,
+        SIMPLIFY,
+        COMPILE
+    };
+    static constexpr std::size_t operationCount = 7;
+
+    struct Counters {
+        std::uint64_t calls = 0;
+        std::uint64_t nanoseconds = 0;
+        std::uint64_t allocations = 0;
+    };
+
+    static bool enabled();
+    static Counters get(Operation operation);
+    // Имя операции в метриках: "evaluate", "compiled_evaluate", ...
+    static const char* name(Operation operation);
+    // Все счётчики плоским списком "expression.<операция>.<счётчик>" -> значение
+    static std::vector<std::pair<std::string, std::uint64_t>> snapshot();
+    static void reset();
+};
+
+#endif // EXPRESSION_COUNTERS_HPP
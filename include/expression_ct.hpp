@@ -0,0 +1,360 @@
+#ifndef EXPRESSION_CT_HPP
+#define EXPRESSION_CT_HPP
+
+#include "expression.hpp"
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Выражения, заданные на этапе компиляции: структура формулы хранится в типе,
+// поэтому вычисление - это встроенный код без узлов, shared_ptr и switch по
+// типу узла. Переменные нумеруются: ct::variable<0>, ct::variable<1>, ...;
+// f(1.5, 2.0) подставляет аргументы по номерам и считает в их общем типе;
+// целые аргументы приводятся к double.
+//
+//   constexpr auto x = ct::variable<0>;
+//   auto f = x * x + ct::sin(x);
+//   double v = f(1.5);
+//   auto df = f.derivative<0>();         // 2x + cos(x), тип вычислен компилятором
+//   Expression<double> e = f.toExpression<double>({"x"});
+//
+// Производная строится на этапе компиляции: нули и единицы - отдельные типы
+// Zero и One, и слагаемые и множители с ними исчезают из типа результата.
+// Константы хранятся как double. Выражения без sin, cos, exp и log можно
+// вычислять в constexpr-контексте. Показатель pow только числовой.
+namespace ct {
+
+template <typename E>
+struct Base;
+
+template <typename E>
+constexpr bool isExpression = std::is_base_of_v<Base<E>, E>;
+
+// Общая часть всех узлов: вызов с аргументами-значениями переменных и
+// доступ к производной и переносу в Expression через тип узла
+template <typename E>
+struct Base {
+    template <typename... Args>
+    constexpr auto operator()(Args... args) const {
+        static_assert(sizeof...(Args) >= E::arity, "Not enough variable values");
+        if constexpr (sizeof...(Args) == 0) {
+            return self().evaluate(static_cast<const double*>(nullptr));
+        } else {
+            // Целые аргументы вычисляются в double: иначе константы и sin
+            // обрезались бы до целых
+            using Common = std::common_type_t<Args...>;
+            using T = std::conditional_t<std::is_integral_v<Common>, double, Common>;
+            const T values[] = {T(args)...};
+            return self().evaluate(values);
+        }
+    }
+
+    template <std::size_t I>
+    constexpr auto derivative() const {
+        return self().template d<I>();
+    }
+
+    // names[i] - имя переменной variable<i>
+    template <typename T>
+    Expression<T> toExpression(const std::vector<std::string>& names) const {
+        return self().template build<T>(names);
+    }
+
+    constexpr const E& self() const { return static_cast<const E&>(*this); }
+};
+
+struct Zero : Base<Zero> {
+    static constexpr std::size_t arity = 0;
+    template <typename T>
+    constexpr T evaluate(const T*) const { return T(0); }
+    template <std::size_t I>
+    constexpr Zero d() const { return {}; }
+    template <typename T>
+    Expression<T> build(const std::vector<std::string>&) const { return Expression<T>(T(0)); }
+};
+
+struct One : Base<One> {
+    static constexpr std::size_t arity = 0;
+    template <typename T>
+    constexpr T evaluate(const T*) const { return T(1); }
+    template <std::size_t I>
+    constexpr Zero d() const { return {}; }
+    template <typename T>
+    Expression<T> build(const std::vector<std::string>&) const { return Expression<T>(T(1)); }
+};
+
+struct Constant : Base<Constant> {
+    static constexpr std::size_t arity = 0;
+    double value;
+
+    constexpr explicit Constant(double v) : value(v) {}
+    template <typename T>
+    constexpr T evaluate(const T*) const { return T(value); }
+    template <std::size_t I>
+    constexpr Zero d() const { return {}; }
+    template <typename T>
+    Expression<T> build(const std::vector<std::string>&) const { return Expression<T>(T(value)); }
+};
+
+template <std::size_t N>
+struct Variable : Base<Variable<N>> {
+    static constexpr std::size_t arity = N + 1;
+    template <typename T>
+    constexpr T evaluate(const T* values) const { return values[N]; }
+    template <std::size_t I>
+    constexpr auto d() const {
+        if constexpr (I == N) return One{};
+        else return Zero{};
+    }
+    template <typename T>
+    Expression<T> build(const std::vector<std::string>& names) const {
+        if (N >= names.size())
+            throw std::runtime_error("No name for variable " + std::to_string(N));
+        return Expression<T>(names[N]);
+    }
+};
+
+template <std::size_t N>
+constexpr Variable<N> variable{};
+
+// Операнд из числа или готового узла
+template <typename E>
+constexpr auto lift(const E& e) {
+    if constexpr (isExpression<E>) return e;
+    else return Constant(static_cast<double>(e));
+}
+
+template <typename A, typename B>
+constexpr bool operands = (isExpression<A> && (isExpression<B> || std::is_arithmetic_v<B>)) ||
+                          (isExpression<B> && std::is_arithmetic_v<A>);
+
+template <typename Op, typename A, typename B>
+struct Binary : Base<Binary<Op, A, B>> {
+    static constexpr std::size_t arity = A::arity > B::arity ? A::arity : B::arity;
+    A a;
+    B b;
+
+    constexpr Binary(const A& l, const B& r) : a(l), b(r) {}
+    template <typename T>
+    constexpr T evaluate(const T* values) const {
+        return Op::apply(a.evaluate(values), b.evaluate(values));
+    }
+    template <std::size_t I>
+    constexpr auto d() const { return Op::template d<I>(a, b); }
+    template <typename T>
+    Expression<T> build(const std::vector<std::string>& names) const {
+        return Op::apply(a.template build<T>(names), b.template build<T>(names));
+    }
+};
+
+template <typename Op, typename A>
+struct Unary : Base<Unary<Op, A>> {
+    static constexpr std::size_t arity = A::arity;
+    A a;
+
+    constexpr explicit Unary(const A& operand) : a(operand) {}
+    template <typename T>
+    constexpr T evaluate(const T* values) const { return Op::apply(a.evaluate(values)); }
+    template <std::size_t I>
+    constexpr auto d() const { return Op::template d<I>(a); }
+    template <typename T>
+    Expression<T> build(const std::vector<std::string>& names) const {
+        return Op::apply(a.template build<T>(names));
+    }
+};
+
+template <typename A>
+struct Power : Base<Power<A>> {
+    static constexpr std::size_t arity = A::arity;
+    A base;
+    double exponent;
+
+    constexpr Power(const A& b, double n) : base(b), exponent(n) {}
+    template <typename T>
+    T evaluate(const T* values) const { return std::pow(base.evaluate(values), T(exponent)); }
+    template <std::size_t I>
+    constexpr auto d() const;
+    template <typename T>
+    Expression<T> build(const std::vector<std::string>& names) const {
+        return Expression<T>::pow(base.template build<T>(names), Expression<T>(T(exponent)));
+    }
+};
+
+struct Add;
+struct Subtract;
+struct Multiply;
+struct Divide;
+struct Negate;
+struct Sin;
+struct Cos;
+struct Exp;
+struct Log;
+
+// Построители узлов: нули и единицы сворачиваются по типу
+template <typename A, typename B>
+constexpr auto add(const A& a, const B& b) {
+    if constexpr (std::is_same_v<A, Zero>) return b;
+    else if constexpr (std::is_same_v<B, Zero>) return a;
+    else return Binary<Add, A, B>(a, b);
+}
+
+template <typename A>
+constexpr auto negate(const A& a) {
+    if constexpr (std::is_same_v<A, Zero>) return a;
+    else return Unary<Negate, A>(a);
+}
+
+template <typename A, typename B>
+constexpr auto subtract(const A& a, const B& b) {
+    if constexpr (std::is_same_v<B, Zero>) return a;
+    else if constexpr (std::is_same_v<A, Zero>) return negate(b);
+    else return Binary<Subtract, A, B>(a, b);
+}
+
+template <typename A, typename B>
+constexpr auto multiply(const A& a, const B& b) {
+    if constexpr (std::is_same_v<A, Zero> || std::is_same_v<B, One>) return a;
+    else if constexpr (std::is_same_v<B, Zero> || std::is_same_v<A, One>) return b;
+    else return Binary<Multiply, A, B>(a, b);
+}
+
+template <typename A, typename B>
+constexpr auto divide(const A& a, const B& b) {
+    if constexpr (std::is_same_v<A, Zero> || std::is_same_v<B, One>) return a;
+    else return Binary<Divide, A, B>(a, b);
+}
+
+template <typename A, typename B, typename = std::enable_if_t<operands<A, B>>>
+constexpr auto operator+(const A& a, const B& b) { return add(lift(a), lift(b)); }
+
+template <typename A, typename B, typename = std::enable_if_t<operands<A, B>>>
+constexpr auto operator-(const A& a, const B& b) { return subtract(lift(a), lift(b)); }
+
+template <typename A, typename B, typename = std::enable_if_t<operands<A, B>>>
+constexpr auto operator*(const A& a, const B& b) { return multiply(lift(a), lift(b)); }
+
+template <typename A, typename B, typename = std::enable_if_t<operands<A, B>>>
+constexpr auto operator/(const A& a, const B& b) { return divide(lift(a), lift(b)); }
+
+template <typename A, typename = std::enable_if_t<isExpression<A>>>
+constexpr auto operator-(const A& a) { return negate(a); }
+
+template <typename A, typename = std::enable_if_t<isExpression<A>>>
+constexpr auto sin(const A& a) { return Unary<Sin, A>(a); }
+
+template <typename A, typename = std::enable_if_t<isExpression<A>>>
+constexpr auto cos(const A& a) { return Unary<Cos, A>(a); }
+
+template <typename A, typename = std::enable_if_t<isExpression<A>>>
+constexpr auto exp(const A& a) { return Unary<Exp, A>(a); }
+
+template <typename A, typename = std::enable_if_t<isExpression<A>>>
+constexpr auto log(const A& a) { return Unary<Log, A>(a); }
+
+template <typename A, typename = std::enable_if_t<isExpression<A>>>
+constexpr auto pow(const A& base, double exponent) { return Power<A>(base, exponent); }
+
+// Операции: значение, перенос в Expression (тот же apply) и правило производной
+struct Add {
+    template <typename T>
+    static constexpr T apply(const T& a, const T& b) { return a + b; }
+    template <std::size_t I, typename A, typename B>
+    static constexpr auto d(const A& a, const B& b) {
+        return add(a.template d<I>(), b.template d<I>());
+    }
+};
+
+struct Subtract {
+    template <typename T>
+    static constexpr T apply(const T& a, const T& b) { return a - b; }
+    template <std::size_t I, typename A, typename B>
+    static constexpr auto d(const A& a, const B& b) {
+        return subtract(a.template d<I>(), b.template d<I>());
+    }
+};
+
+struct Multiply {
+    template <typename T>
+    static constexpr T apply(const T& a, const T& b) { return a * b; }
+    // (uv)' = u'v + uv'
+    template <std::size_t I, typename A, typename B>
+    static constexpr auto d(const A& a, const B& b) {
+        return add(multiply(a.template d<I>(), b), multiply(a, b.template d<I>()));
+    }
+};
+
+struct Divide {
+    template <typename T>
+    static constexpr T apply(const T& a, const T& b) { return a / b; }
+    // (u/v)' = (u'v - uv')/v^2
+    template <std::size_t I, typename A, typename B>
+    static constexpr auto d(const A& a, const B& b) {
+        return divide(subtract(multiply(a.template d<I>(), b), multiply(a, b.template d<I>())),
+                      multiply(b, b));
+    }
+};
+
+struct Negate {
+    template <typename T>
+    static constexpr T apply(const T& a) { return -a; }
+    template <std::size_t I, typename A>
+    static constexpr auto d(const A& a) { return negate(a.template d<I>()); }
+};
+
+struct Sin {
+    template <typename T>
+    static T apply(const T& a) { return std::sin(a); }
+    template <typename T>
+    static Expression<T> apply(const Expression<T>& a) { return Expression<T>::sin(a); }
+    template <std::size_t I, typename A>
+    static constexpr auto d(const A& a) { return multiply(Unary<Cos, A>(a), a.template d<I>()); }
+};
+
+struct Cos {
+    template <typename T>
+    static T apply(const T& a) { return std::cos(a); }
+    template <typename T>
+    static Expression<T> apply(const Expression<T>& a) { return Expression<T>::cos(a); }
+    template <std::size_t I, typename A>
+    static constexpr auto d(const A& a) {
+        return multiply(negate(Unary<Sin, A>(a)), a.template d<I>());
+    }
+};
+
+struct Exp {
+    template <typename T>
+    static T apply(const T& a) { return std::exp(a); }
+    template <typename T>
+    static Expression<T> apply(const Expression<T>& a) { return Expression<T>::exp(a); }
+    template <std::size_t I, typename A>
+    static constexpr auto d(const A& a) { return multiply(Unary<Exp, A>(a), a.template d<I>()); }
+};
+
+struct Log {
+    template <typename T>
+    static T apply(const T& a) { return std::log(a); }
+    template <typename T>
+    static Expression<T> apply(const Expression<T>& a) { return Expression<T>::log(a); }
+    template <std::size_t I, typename A>
+    static constexpr auto d(const A& a) { return divide(a.template d<I>(), a); }
+};
+
+// (u^n)' = n u^(n-1) u'
+template <typename A>
+template <std::size_t I>
+constexpr auto Power<A>::d() const {
+    return multiply(multiply(Constant(exponent), Power<A>(base, exponent - 1)),
+                    base.template d<I>());
+}
+
+template <std::size_t I, typename E, typename = std::enable_if_t<isExpression<E>>>
+constexpr auto derivative(const E& e) {
+    return e.template d<I>();
+}
+
+} // namespace ct
+
+#endif // EXPRESSION_CT_HPP
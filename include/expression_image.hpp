@@ -0,0 +1,109 @@
+#ifndef EXPRESSION_IMAGE_HPP
+#define EXPRESSION_IMAGE_HPP
+
+#include "expression.hpp"
+
+// Двоичный образ набора выражений (Expression::serialize) и чтение из него
+// без копирования: образ можно отобразить из файла и вычислять прямо по нему.
+//
+// Формат, версия 2 (порядок байтов хоста, все смещения от начала образа):
+//   Header                          - 48 байт
+//   T constants[constantCount]
+//   Node nodes[nodeCount]           - по 12 байт
+//   uint32 operands[operandCount]   - потомки n-арных узлов, номера узлов
+//   uint32 roots[rootCount]         - корни выражений, номера узлов
+//   uint32 offsets[symbolCount + 1] - границы имён в names
+//   char names[nameBytes]           - имена переменных подряд, без нулей
+// Узлы хранятся в порядке обхода: потомок всегда раньше родителя. Общие
+// подвыражения, в том числе между разными корнями, записаны один раз.
+// Коды типов узлов совпадают с кодами Expression; первые 12 из них - с
+// ExpressionArena::Type.
+template <typename T>
+class ExpressionImage {
+public:
+    using Id = std::uint32_t;
+
+    static constexpr std::uint16_t version = 2;
+
+    struct Header {
+        char magic[4];
+        // 0x01020304 в порядке байтов записавшей машины
+        std::uint32_t byteOrder;
+        std::uint16_t version;
+        // 0 - double, 1 - complex<double>
+        std::uint8_t scalar;
+        std::uint8_t reserved;
+        std::uint32_t nodeCount;
+        std::uint32_t constantCount;
+        std::uint32_t symbolCount;
+        std::uint32_t rootCount;
+        std::uint32_t nameBytes;
+        std::uint32_t operandCount;
+        std::uint32_t padding;
+        // Полный размер образа в байтах
+        std::uint64_t size;
+    };
+
+    // У CONSTANT left - номер константы, у VARIABLE - номер имени образа, у
+    // унарных операций right == none, у n-арных (SUM, COMPENSATED_SUM, PRODUCT)
+    // left - начало потомков в operands, right - их число. SHARED - у узла больше одного родителя
+    // (или он ещё и корень): при обходе его значение запоминается.
+    struct Node {
+        std::uint8_t type;
+        std::uint8_t flags;
+        std::uint16_t reserved;
+        Id left;
+        Id right;
+    };
+
+    static constexpr std::uint8_t SHARED = 1;
+    static constexpr Id none = ~Id(0);
+
+    // Вид на готовый образ; память должна жить дольше ExpressionImage и быть
+    // выровнена как T. Заголовок и все номера проверяются сразу, ошибка -
+    // runtime_error.
+    ExpressionImage(const void* data, std::size_t size);
+    // Отображение файла только для чтения (POSIX mmap)
+    static ExpressionImage map(const std::string& path);
+
+    ExpressionImage(const ExpressionImage&) = delete;
+    ExpressionImage& operator=(const ExpressionImage&) = delete;
+    ExpressionImage(ExpressionImage&& other) noexcept;
+    ExpressionImage& operator=(ExpressionImage&& other) noexcept;
+    ~ExpressionImage();
+
+    // Число выражений в образе
+    std::size_t size() const { return header->rootCount; }
+    std::size_t variableCount() const { return header->symbolCount; }
+    // Имя указывает в образ
+    std::string_view variable(std::size_t index) const;
+
+    // values[i] - значение variable(i)
+    T evaluate(std::size_t index, const T* values) const;
+    T evaluate(std::size_t index, const std::map<std::string, T>& variables = {}) const;
+
+    // Перенос в обычные выражения; узлы хэш-консятся с уже существующими
+    Expression<T> expression(std::size_t index) const;
+
+private:
+    const unsigned char* data = nullptr;
+    // Отображённая область, если образ открыт через map()
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
+
+    const Header* header = nullptr;
+    const T* constants = nullptr;
+    const Node* nodes = nullptr;
+    const Id* operands = nullptr;
+    const Id* roots = nullptr;
+    const std::uint32_t* offsets = nullptr;
+    const char* names = nullptr;
+
+    ExpressionImage() = default;
+    void attach(const void* data, std::size_t size);
+    Id root(std::size_t index) const;
+    template <typename Variable>
+    T run(Id root, Variable&& variable) const;
+};
+
+#endif // EXPRESSION_IMAGE_HPP
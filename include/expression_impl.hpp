@@ -0,0 +1,34 @@
+#ifndef EXPRESSION_IMPL_HPP
+#define EXPRESSION_IMPL_HPP
+
+// Определения шаблонов Expression и CompiledExpression для типов значений,
+// которых нет в библиотеке (требования к типу - в expression_traits.hpp):
+//
+//     #include "expression_impl.hpp"
+//     Expression<float> x("x");
+//     float y = sin(x * x).derivative("x").compile().evaluate({{"x", 0.5f}});
+//
+// Определения в заголовке позволяют компилятору встроить операции float и
+// собственных типов в циклы вычисления. Для double и complex<double>
+// объявления extern template ниже берут готовый код из библиотеки, поэтому
+// единица трансляции с этим заголовком не компилирует их заново. Остальной
+// программе достаточно expression.hpp.
+#include "expression.hpp"
+#include "detail/batch_impl.hpp"
+#include "detail/compiled_impl.hpp"
+#include "detail/dual_impl.hpp"
+#include "detail/expression_impl.hpp"
+#include "detail/gradient_impl.hpp"
+#include "detail/hessian_impl.hpp"
+#include "detail/parse_impl.hpp"
+#include "detail/simplify_impl.hpp"
+#include "detail/stats_impl.hpp"
+
+extern template class Expression<double>;
+extern template class Expression<std::complex<double>>;
+extern template class CompiledExpression<double>;
+extern template class CompiledExpression<std::complex<double>>;
+extern template class DerivativeContext<double>;
+extern template class DerivativeContext<std::complex<double>>;
+
+#endif // EXPRESSION_IMPL_HPP
@@ -0,0 +1,72 @@
+#ifndef EXPRESSION_INCREMENTAL_HPP
+#define EXPRESSION_INCREMENTAL_HPP
+
+#include "expression.hpp"
+
+// Вычислитель с состоянием для случая, когда между вычислениями меняются
+// лишь несколько переменных.
+//
+// Хранит последнее значение каждого узла и для каждой переменной - список
+// зависящих от неё узлов в порядке от потомков к родителям. result()
+// пересчитывает только узлы, зависящие от изменённых через set переменных,
+// и только если значение хотя бы одного операнда действительно изменилось;
+// поддеревья без этих переменных (в том числе дорогие sin, exp, log, pow)
+// не пересчитываются.
+// Не потокобезопасен: у каждого потока должен быть свой вычислитель.
+template <typename T>
+class IncrementalEvaluator {
+public:
+    explicit IncrementalEvaluator(const Expression<T>& expr);
+    IncrementalEvaluator(const Expression<T>& expr, const std::map<std::string, T>& values);
+
+    // Переменные выражения в порядке слотов
+    const std::vector<std::string>& variables() const { return slots; }
+    // Номер слота; runtime_error, если переменной нет в выражении
+    std::size_t slot(const std::string& variable) const;
+
+    // Переменные, которых нет в выражении, игнорируются
+    void set(const std::string& variable, T value);
+    void set(std::size_t slot, T value);
+
+    // Значение выражения; до первого вызова должны быть заданы все переменные
+    T result();
+    // Сколько узлов пересчитал последний result()
+    std::size_t recomputed() const { return lastRecomputed; }
+
+private:
+    using Id = std::uint32_t;
+
+    struct Step {
+        std::uint8_t type;
+        Id lhs;
+        Id rhs;
+    };
+
+    std::vector<Step> steps;
+    // Номера потомков n-арных узлов
+    std::vector<Id> operands;
+    std::vector<T> values;
+    std::vector<std::string> slots;
+    // Узел VARIABLE каждого слота
+    std::vector<Id> slotNodes;
+    // Зависимые узлы слота s: dependents[first[s]..first[s + 1]) по возрастанию
+    std::vector<Id> first;
+    std::vector<Id> dependents;
+
+    std::vector<bool> assigned;
+    std::vector<Id> dirtySlots;
+    std::vector<bool> dirty;
+    // Отметки изменившихся узлов на время одного result()
+    std::vector<bool> changed;
+    std::vector<Id> merged;
+    // Второй буфер для слияния списков зависимых узлов в merged
+    std::vector<Id> mergeBuffer;
+    std::vector<T> scratch;
+    bool computed = false;
+    std::size_t lastRecomputed = 0;
+
+    T compute(const Step& step);
+    static bool nary(const Step& step);
+};
+
+#endif // EXPRESSION_INCREMENTAL_HPP
@@ -0,0 +1,44 @@
+#ifndef EXPRESSION_INTERVAL_HPP
+#define EXPRESSION_INTERVAL_HPP
+
+#include "expression.hpp"
+
+// Отрезок [lo, hi] на прямой; бесконечные концы допустимы
+struct Interval {
+    double lo;
+    double hi;
+};
+
+// Интервальное вычисление скомпилированной программы: по отрезкам значений
+// переменных - отрезок, гарантированно содержащий значение выражения в
+// каждой точке этого бокса. Подходит для метода ветвей и границ: область
+// отбрасывается целиком, без вычислений в точках.
+//
+// Каждая операция округляет наружу: концы, полученные округлением к
+// ближайшему, сдвигаются на ulp (для sin, cos, exp, log и pow - на два ulp,
+// в пределах погрешности glibc), поэтому границы надёжны и немного шире
+// точных. Границы sin и cos учитывают экстремумы внутри отрезка. Деление на
+// отрезок, содержащий 0, даёт всю прямую. Если выражение не определено на
+// части бокса (log или sqrt отрицательного, нецелая степень отрицательного
+// основания), границы берутся по определённой части, а если оно нигде не
+// определено - концы равны NaN; с NaN любое сравнение ложно, поэтому такая
+// область не отбрасывается.
+class IntervalExpression {
+public:
+    explicit IntervalExpression(const Expression<double>& expr);
+    explicit IntervalExpression(const CompiledExpression<double>& compiled);
+
+    // values[i] - отрезок переменной variables()[i]
+    Interval evaluate(const Interval* values) const;
+    Interval evaluate(const std::map<std::string, Interval>& variables) const;
+    // registers должен вмещать registerCount() элементов
+    Interval evaluate(const Interval* values, Interval* registers) const;
+
+    const std::vector<std::string>& variables() const { return compiled.variables(); }
+    std::size_t registerCount() const { return compiled.registerCount(); }
+
+private:
+    CompiledExpression<double> compiled;
+};
+
+#endif // EXPRESSION_INTERVAL_HPP
@@ -0,0 +1,46 @@
+#ifndef EXPRESSION_JIT_HPP
+#define EXPRESSION_JIT_HPP
+
+#include "expression.hpp"
+
+// Выражение, переведённое в машинный код: функция T(const T* values), где
+// values[i] - значение переменной variables()[i].
+//
+// Код генерируется для x86-64 (System V, SSE2) по программе CompiledExpression:
+// её регистры отображаются на xmm0-xmm13, остальные хранятся в кадре стека.
+// Функции libm и комплексное умножение и деление вызываются через указатели на
+// ячейки кадра. На других платформах конструктор бросает runtime_error.
+//
+// Собирается отдельной библиотекой libexpression_jit.a (make jit), поэтому
+// основная библиотека не зависит от mmap и генератора кода.
+template <typename T>
+class JitExpression {
+public:
+    using Function = T (*)(const T* values);
+
+    explicit JitExpression(const Expression<T>& expr);
+    explicit JitExpression(const CompiledExpression<T>& compiled);
+
+    JitExpression(const JitExpression&) = delete;
+    JitExpression& operator=(const JitExpression&) = delete;
+    JitExpression(JitExpression&& other) noexcept;
+    JitExpression& operator=(JitExpression&& other) noexcept;
+    ~JitExpression();
+
+    T operator()(const T* values) const { return entry(values); }
+    T evaluate(const std::map<std::string, T>& variables = {}) const;
+
+    Function function() const { return entry; }
+    const std::vector<std::string>& variables() const { return slots; }
+    // Размер сгенерированного кода в байтах
+    std::size_t codeSize() const { return code; }
+
+private:
+    void* memory = nullptr;
+    std::size_t size = 0;
+    std::size_t code = 0;
+    Function entry = nullptr;
+    std::vector<std::string> slots;
+};
+
+#endif // EXPRESSION_JIT_HPP
@@ -0,0 +1,203 @@
+#ifndef EXPRESSION_TRAITS_HPP
+#define EXPRESSION_TRAITS_HPP
+
+#include <charconv>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+// Математические функции значений: std для встроенных типов, функции из
+// пространства имён типа - для собственных
+namespace scalar {
+
+// FNV-1a по байтам значения
+inline std::size_t hashBytes(const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::size_t h = 1469598103934665603ULL;
+    for (std::size_t i = 0; i < size; ++i) h = (h ^ bytes[i]) * 1099511628211ULL;
+    return h;
+}
+
+template <typename T>
+T sin(const T& x) {
+    using std::sin;
+    return sin(x);
+}
+
+template <typename T>
+T cos(const T& x) {
+    using std::cos;
+    return cos(x);
+}
+
+template <typename T>
+T exp(const T& x) {
+    using std::exp;
+    return exp(x);
+}
+
+template <typename T>
+T log(const T& x) {
+    using std::log;
+    return log(x);
+}
+
+template <typename T>
+T sqrt(const T& x) {
+    using std::sqrt;
+    return sqrt(x);
+}
+
+template <typename T>
+T pow(const T& x, const T& y) {
+    using std::pow;
+    return pow(x, y);
+}
+
+} // namespace scalar
+
+// Требования к типу значений T в Expression<T> и CompiledExpression<T>.
+//
+// Библиотека собрана для double и complex<double>; для других типов
+// (float, long double, complex<float>, собственные числа) определения
+// шаблонов подключаются из expression_impl.hpp и инстанцируются в
+// программе пользователя. T должен:
+//   - конструироваться по умолчанию и из double (T(0), T(1), T(2), T(0.5));
+//   - копироваться и присваиваться;
+//   - поддерживать +, -, *, /, унарный минус, +=, -=, *=, == и !=;
+//   - иметь sin, cos, exp, log, sqrt и pow(T, T) в std или в своём
+//     пространстве имён (находятся поиском, зависящим от аргументов).
+// Остальное описывает ScalarTraits<T>; общий вариант подходит любому такому
+// типу, а его можно специализировать, чтобы включить быстрые пути. Общие
+// same и hash сравнивают байты значения, поэтому годятся только для типов,
+// у которых равные значения совпадают побитово (без выравнивания и
+// владеющих указателей); для остальных их нужно специализировать, иначе
+// равные константы не разделяются хэш-консингом.
+//
+// Сериализация, ExpressionImage, ExpressionArena, IncrementalEvaluator,
+// ExpressionBundle, IntervalExpression и JIT остаются только для double и
+// complex<double>.
+template <typename T, typename = void>
+struct ScalarTraits {
+    // Комплексная константа в тексте записывается как (re,im)
+    static constexpr bool isComplex = false;
+
+    // Действительное значение для выбора быстрого пути степени (x^2, x^-1,
+    // x^0.5, x^n); false - всегда общий pow
+    static bool real(const T&, double&) { return false; }
+
+    // Коэффициент, который simplify записывает вычитанием
+    static bool negative(const T&) { return false; }
+
+    // Конечное значение; поправка компенсированной суммы от неконечного
+    // заменяется нулём. Общий вариант считает конечным всё
+    static bool finite(const T&) { return true; }
+
+    // Константа в toString; разбор ожидает запись, которую понимает parse
+    static void format(std::string& out, const T& value) {
+        std::ostringstream stream;
+        stream << value;
+        out += stream.str();
+    }
+
+    // Хэш-консинг различает константы побитово, чтобы NaN и -0 тоже
+    // разделялись корректно
+    static bool same(const T& a, const T& b) {
+        static_assert(std::has_unique_object_representations_v<T>,
+                      "ScalarTraits<T>::same and hash must be specialised for this T");
+        return std::memcmp(&a, &b, sizeof(T)) == 0;
+    }
+    static std::size_t hash(const T& value) {
+        static_assert(std::has_unique_object_representations_v<T>,
+                      "ScalarTraits<T>::same and hash must be specialised for this T");
+        return scalar::hashBytes(&value, sizeof(T));
+    }
+};
+
+template <typename F>
+struct ScalarTraits<F, std::enable_if_t<std::is_floating_point_v<F>>> {
+    static constexpr bool isComplex = false;
+
+    // Значащие байты: у 80-битного long double x87 остальные - выравнивание
+    // с произвольным содержимым
+    static constexpr std::size_t bytes =
+        std::numeric_limits<F>::digits == 64 && sizeof(F) > 10 ? 10 : sizeof(F);
+
+    // Только если значение представимо в double точно: иначе, например,
+    // 0.5000000000000000001L попало бы на путь sqrt
+    static bool real(const F& value, double& out) {
+        out = static_cast<double>(value);
+        return static_cast<F>(out) == value;
+    }
+
+    static bool negative(const F& value) { return value < 0; }
+
+    static bool finite(const F& value) { return std::isfinite(value); }
+
+    // Тот же вид, что у operator<< с точностью по умолчанию
+    static void format(std::string& out, const F& value) {
+        char buffer[64];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                                    std::chars_format::general, 6);
+        out.append(buffer, result.ptr);
+    }
+
+    static bool same(const F& a, const F& b) { return std::memcmp(&a, &b, bytes) == 0; }
+    static std::size_t hash(const F& value) {
+        return scalar::hashBytes(&value, bytes);
+    }
+};
+
+template <typename F>
+struct ScalarTraits<std::complex<F>, std::enable_if_t<std::is_floating_point_v<F>>> {
+    using Part = ScalarTraits<F>;
+
+    static constexpr bool isComplex = true;
+
+    static bool real(const std::complex<F>& value, double& out) {
+        if (value.imag() != F(0)) return false;
+        return Part::real(value.real(), out);
+    }
+
+    static bool negative(const std::complex<F>& value) {
+        return value.imag() == F(0) && value.real() < F(0);
+    }
+
+    static bool finite(const std::complex<F>& value) {
+        return Part::finite(value.real()) && Part::finite(value.imag());
+    }
+
+    static void format(std::string& out, const std::complex<F>& value) {
+        out += '(';
+        Part::format(out, value.real());
+        out += ',';
+        Part::format(out, value.imag());
+        out += ')';
+    }
+
+    static bool same(const std::complex<F>& a, const std::complex<F>& b) {
+        return Part::same(a.real(), b.real()) && Part::same(a.imag(), b.imag());
+    }
+    static std::size_t hash(const std::complex<F>& value) {
+        return Part::hash(value.real()) * 31 ^ Part::hash(value.imag());
+    }
+};
+
+namespace scalar {
+
+// Поправка суммы по Кахану. После бесконечного слагаемого она была бы
+// inf - inf = NaN и испортила бы сумму, которая без поправки равна inf,
+// поэтому неконечная поправка заменяется нулём
+template <typename T>
+T compensation(const T& value) {
+    return ScalarTraits<T>::finite(value) ? value : T(0);
+}
+
+} // namespace scalar
+
+#endif // EXPRESSION_TRAITS_HPP
@@ -0,0 +1,43 @@
+#ifndef EXPRESSION_THREAD_POOL_HPP
+#define EXPRESSION_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// Пул потоков для параллельного пакетного вычисления.
+//
+// parallelFor делит номера фрагментов [0, count) на непрерывные отрезки по
+// одному на поток. Поток берёт фрагменты из начала своего отрезка, а
+// закончив его, забирает половину чужого отрезка с конца. Отрезок - одно
+// атомарное слово, поэтому синхронизация идёт на фрагмент, а не на строку.
+//
+// Вызывающий поток работает наравне с потоками пула. Одновременные вызовы
+// parallelFor одного пула выполняются по очереди; вызов изнутри задачи
+// выполняется последовательно в том же потоке.
+class ThreadPool {
+public:
+    // threads - число потоков вместе с вызывающим; 0 - по числу ядер
+    explicit ThreadPool(std::size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Общий пул процесса по числу ядер, создаётся при первом обращении
+    static ThreadPool& shared();
+
+    std::size_t size() const;
+
+    // task(i) для каждого i из [0, count) не больше чем в limit потоках
+    // (0 - во всех); возвращает управление, когда все фрагменты выполнены.
+    // Первое исключение задачи пробрасывается, оставшиеся фрагменты пропускаются.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task,
+                     std::size_t limit = 0);
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+#endif // EXPRESSION_THREAD_POOL_HPP
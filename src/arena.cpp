@@ -0,0 +1,418 @@
+#include "expression_arena.hpp"
+#include "detail/node.hpp"
+#include "detail/parser.hpp"
+#include "detail/power.hpp"
+#include "detail/symbols.hpp"
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// constantExponent: показатель POWER - узел CONSTANT, и степень считается
+// так же, как в остальных вычислителях
+template <typename Type, typename T>
+T apply(Type type, const T& a, const T& b, bool constantExponent) {
+    switch (type) {
+        case Type::ADD: return a + b;
+        case Type::SUBTRACT: return a - b;
+        case Type::MULTIPLY: return a * b;
+        case Type::DIVIDE: return a / b;
+        case Type::POWER: return constantExponent ? power::constant(a, b) : std::pow(a, b);
+        case Type::SIN: return std::sin(a);
+        case Type::COS: return std::cos(a);
+        case Type::EXP: return std::exp(a);
+        case Type::LOG: return std::log(a);
+        case Type::NEGATE: return -a;
+        case Type::CONSTANT:
+        case Type::VARIABLE:
+            break;
+    }
+    return T(0);
+}
+
+// Операнд при переносе n-арного узла: операции над ним создают узлы арены,
+// поэтому Node::reduce раскладывает узел в те же бинарные операции, что
+// выполняет при вычислении
+template <typename T>
+struct Operand {
+    ExpressionArena<T>* arena;
+    typename ExpressionArena<T>::Id id;
+
+    friend Operand operator+(const Operand& a, const Operand& b) {
+        return {a.arena, a.arena->add(a.id, b.id)};
+    }
+    friend Operand operator-(const Operand& a, const Operand& b) {
+        return {a.arena, a.arena->subtract(a.id, b.id)};
+    }
+    friend Operand operator*(const Operand& a, const Operand& b) {
+        return {a.arena, a.arena->multiply(a.id, b.id)};
+    }
+    // Замены неконечной поправки нулём в арене нет: поправка остаётся как есть
+    friend Operand compensation(const Operand& a) { return a; }
+};
+
+} // namespace
+
+// Построение узлов
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::constant(T value) {
+    // Значение кладётся в таблицу заранее и убирается, если узел уже есть
+    Node node{Type::CONSTANT, static_cast<Id>(constants.size()), none};
+    constants.push_back(value);
+    Id id = intern(node, hashOf(node));
+    if (nodes[id].left != node.left) constants.pop_back();
+    return id;
+}
+
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::variable(const string& name) {
+    Node node{Type::VARIABLE, SymbolTable::intern(name), none};
+    return intern(node, hashOf(node));
+}
+
+template <typename T>
+const string& ExpressionArena<T>::name(Id id) const {
+    return SymbolTable::name(nodes[id].left);
+}
+
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::make(Type type, Id left, Id right) {
+    Node node{type, left, right};
+    return intern(node, hashOf(node));
+}
+
+template <typename T>
+size_t ExpressionArena<T>::hashOf(const Node& node) const {
+    size_t h = (static_cast<size_t>(node.type) + 1) * 0x9e3779b97f4a7c15ULL;
+    switch (node.type) {
+        case Type::CONSTANT:
+            h ^= Expression<T>::Node::hashValue(constants[node.left]);
+            break;
+        default:
+            h = (h ^ node.left) * 0x100000001b3ULL;
+            h = (h ^ node.right) * 0x100000001b3ULL;
+            break;
+    }
+    return h ^ (h >> 29);
+}
+
+template <typename T>
+bool ExpressionArena<T>::equal(const Node& a, const Node& b) const {
+    if (a.type != b.type) return false;
+    switch (a.type) {
+        case Type::CONSTANT:
+            return Expression<T>::Node::sameValue(constants[a.left], constants[b.left]);
+        default:
+            return a.left == b.left && a.right == b.right;
+    }
+}
+
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::intern(const Node& node, size_t hash) {
+    // Заполнение таблицы не выше половины
+    if (2 * (nodes.size() + 1) > table.size()) rehash(table.empty() ? 64 : 2 * table.size());
+    size_t mask = table.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Id id = table[i];
+        if (id == none) {
+            if (nodes.size() >= none) throw runtime_error("Expression arena is full");
+            id = static_cast<Id>(nodes.size());
+            nodes.push_back(node);
+            table[i] = id;
+            return id;
+        }
+        if (equal(nodes[id], node)) return id;
+    }
+}
+
+template <typename T>
+void ExpressionArena<T>::rehash(size_t capacity) {
+    table.assign(capacity, none);
+    size_t mask = capacity - 1;
+    for (Id id = 0; id < nodes.size(); ++id) {
+        size_t i = hashOf(nodes[id]) & mask;
+        while (table[i] != none) i = (i + 1) & mask;
+        table[i] = id;
+    }
+}
+
+template <typename T>
+void ExpressionArena<T>::reserve(size_t count) {
+    nodes.reserve(count);
+    size_t capacity = 64;
+    while (capacity < 2 * count) capacity *= 2;
+    if (capacity > table.size()) rehash(capacity);
+}
+
+template <typename T>
+void ExpressionArena<T>::clear() {
+    // swap вместо clear(), чтобы вернуть память, а не только обнулить размер
+    vector<Node>().swap(nodes);
+    vector<T>().swap(constants);
+    vector<Id>().swap(table);
+}
+
+template <typename T>
+vector<bool> ExpressionArena<T>::reachable(Id node) const {
+    vector<bool> marks(node + 1, false);
+    marks[node] = true;
+    for (Id i = node + 1; i-- > 0;) {
+        if (!marks[i]) continue;
+        const Node& n = nodes[i];
+        if (n.type == Type::CONSTANT || n.type == Type::VARIABLE) continue;
+        marks[n.left] = true;
+        if (n.right != none) marks[n.right] = true;
+    }
+    return marks;
+}
+
+// Вычисление выражения
+template <typename T>
+T ExpressionArena<T>::evaluate(Id node, const map<string, T>& variables) const {
+    vector<bool> marks = reachable(node);
+    vector<T> values(node + 1);
+    for (Id i = 0; i <= node; ++i) {
+        if (!marks[i]) continue;
+        const Node& n = nodes[i];
+        if (n.type == Type::CONSTANT) {
+            values[i] = constants[n.left];
+        } else if (n.type == Type::VARIABLE) {
+            const string& name = SymbolTable::name(n.left);
+            auto it = variables.find(name);
+            if (it == variables.end()) throw runtime_error("Undefined variable: " + name);
+            values[i] = it->second;
+        } else {
+            bool constantExponent = n.type == Type::POWER && nodes[n.right].type == Type::CONSTANT;
+            values[i] = apply(n.type, values[n.left], n.right != none ? values[n.right] : T(0),
+                              constantExponent);
+        }
+    }
+    return values[node];
+}
+
+template <typename T>
+bool ExpressionArena<T>::isConstant(Id node) const {
+    vector<bool> marks = reachable(node);
+    for (Id i = 0; i <= node; ++i) {
+        if (marks[i] && nodes[i].type == Type::VARIABLE) return false;
+    }
+    return true;
+}
+
+// Вычисление производной
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::derivative(Id node, const string& variable) {
+    SymbolTable::Symbol symbol = SymbolTable::find(variable);
+    vector<bool> marks = reachable(node);
+    vector<Id> d(node + 1, none);
+    // Для показателя степени нужно знать, константен ли он и чему равен
+    vector<bool> fixed(node + 1, true);
+    vector<T> values(node + 1);
+    // Константы хэш-консятся, так что нулевая производная - это ровно этот узел
+    const Id zero = constant(T(0));
+
+    for (Id i = 0; i <= node; ++i) {
+        if (!marks[i]) continue;
+        // Копия: построение новых узлов может перераспределить nodes
+        const Node n = nodes[i];
+        Id u = n.left, v = n.right;
+        switch (n.type) {
+            case Type::CONSTANT:
+                values[i] = constants[n.left];
+                d[i] = constant(T(0));
+                continue;
+            case Type::VARIABLE:
+                fixed[i] = false;
+                d[i] = constant(n.left == symbol ? T(1) : T(0));
+                continue;
+            default:
+                break;
+        }
+        fixed[i] = fixed[u] && (v == none || fixed[v]);
+        if (fixed[i]) {
+            bool constantExponent = n.type == Type::POWER && nodes[v].type == Type::CONSTANT;
+            values[i] = apply(n.type, values[u], v != none ? values[v] : T(0), constantExponent);
+        }
+
+        switch (n.type) {
+            case Type::ADD:
+            case Type::SUBTRACT:
+                d[i] = make(n.type, d[u], d[v]);
+                break;
+            case Type::MULTIPLY:
+                // (uv)' = u'v + uv'
+                d[i] = add(multiply(d[u], v), multiply(u, d[v]));
+                break;
+            case Type::DIVIDE:
+                // (u/v)' = (u'v - uv')/v^2
+                d[i] = divide(subtract(multiply(d[u], v), multiply(u, d[v])),
+                              pow(v, constant(T(2))));
+                break;
+            case Type::POWER: {
+                if (fixed[v]) {
+                    // (u^n)' = n*u^(n-1)*u'
+                    T exponent = values[v];
+                    Id scale = constant(exponent);
+                    d[i] = multiply(multiply(scale, pow(u, constant(exponent - T(1)))), d[u]);
+                    break;
+                }
+                if (d[v] == zero) {
+                    // Показатель зависит от других переменных: (u^v)' = v*u^(v-1)*u'
+                    d[i] = multiply(multiply(v, pow(u, subtract(v, constant(T(1))))), d[u]);
+                    break;
+                }
+                // (u^v)' = u^v * (v' * log(u) + v * u'/u); при u' = 0 второе
+                // слагаемое не нужно
+                Id growth = multiply(d[v], log(u));
+                if (d[u] != zero) growth = add(growth, divide(multiply(v, d[u]), u));
+                d[i] = multiply(i, growth);
+                break;
+            }
+            case Type::SIN:
+                d[i] = multiply(cos(u), d[u]);
+                break;
+            case Type::COS:
+                d[i] = multiply(negate(sin(u)), d[u]);
+                break;
+            case Type::EXP:
+                d[i] = multiply(exp(u), d[u]);
+                break;
+            case Type::LOG:
+                d[i] = divide(d[u], u);
+                break;
+            case Type::NEGATE:
+                d[i] = negate(d[u]);
+                break;
+            case Type::CONSTANT:
+            case Type::VARIABLE:
+                break;
+        }
+    }
+    return d[node];
+}
+
+// Подстановка значения переменной
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::substitute(Id node, const string& variable,
+                                                               Id value) {
+    SymbolTable::Symbol symbol = SymbolTable::find(variable);
+    vector<bool> marks = reachable(node);
+    vector<Id> s(node + 1, none);
+    for (Id i = 0; i <= node; ++i) {
+        if (!marks[i]) continue;
+        const Node n = nodes[i];
+        if (n.type == Type::CONSTANT) {
+            s[i] = i;
+        } else if (n.type == Type::VARIABLE) {
+            s[i] = n.left == symbol ? value : i;
+        } else {
+            Id left = s[n.left];
+            Id right = n.right != none ? s[n.right] : none;
+            s[i] = (left == n.left && right == n.right) ? i : make(n.type, left, right);
+        }
+    }
+    return s[node];
+}
+
+// Разбор выражения из текста
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::parse(string_view text) {
+    struct Builder {
+        using Value = Id;
+        ExpressionArena& arena;
+
+        static Type type(parser::Op op) {
+            switch (op) {
+                case parser::Op::ADD: return Type::ADD;
+                case parser::Op::SUBTRACT: return Type::SUBTRACT;
+                case parser::Op::MULTIPLY: return Type::MULTIPLY;
+                case parser::Op::DIVIDE: return Type::DIVIDE;
+                case parser::Op::POWER: return Type::POWER;
+                case parser::Op::SIN: return Type::SIN;
+                case parser::Op::COS: return Type::COS;
+                case parser::Op::EXP: return Type::EXP;
+                case parser::Op::LOG: return Type::LOG;
+                case parser::Op::NEGATE: return Type::NEGATE;
+            }
+            return Type::NEGATE;
+        }
+
+        Value constant(T value) { return arena.constant(value); }
+        Value variable(SymbolTable::Symbol symbol) { return arena.make(Type::VARIABLE, symbol); }
+        Value binary(parser::Op op, Id a, Id b) { return arena.make(type(op), a, b); }
+        Value unary(parser::Op op, Id a) { return arena.make(type(op), a); }
+    };
+
+    Builder builder{*this};
+    return parser::Parser<T, Builder>(text, builder).parse();
+}
+
+// Перенос между ареной и обычными выражениями
+template <typename T>
+typename ExpressionArena<T>::Id ExpressionArena<T>::import(const Expression<T>& expr) {
+    using ExprNode = typename Expression<T>::Node;
+
+    // Постфиксный обход без рекурсии; общие узлы переносятся один раз
+    unordered_map<const ExprNode*, Id> index;
+    vector<pair<const ExprNode*, bool>> stack{{expr.root.get(), false}};
+    while (!stack.empty()) {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+        if (index.count(node)) continue;
+        if (!expanded) {
+            stack.emplace_back(node, true);
+            for (size_t k = node->arity(); k-- > 0;) stack.emplace_back(node->child(k).get(), false);
+            continue;
+        }
+        Id id;
+        if (node->type == ExprNode::Type::CONSTANT) {
+            id = constant(node->value);
+        } else if (node->type == ExprNode::Type::VARIABLE) {
+            id = make(Type::VARIABLE, node->symbol);
+        } else if (node->terms) {
+            // В арене нет n-арных узлов: узел раскладывается в цепочки бинарных
+            vector<Operand<T>> items;
+            items.reserve(node->terms->size());
+            for (const auto& term : *node->terms) items.push_back({this, index[term.get()]});
+            id = ExprNode::reduce(node->type, items.data(), items.size()).id;
+        } else {
+            // Перечисления типов узлов совпадают по порядку
+            id = make(static_cast<Type>(node->type), index[node->left.get()],
+                      node->right ? index[node->right.get()] : none);
+        }
+        index.emplace(node, id);
+    }
+    return index[expr.root.get()];
+}
+
+template <typename T>
+Expression<T> ExpressionArena<T>::toExpression(Id node) const {
+    using ExprNode = typename Expression<T>::Node;
+    using ExprType = typename ExprNode::Type;
+
+    vector<bool> marks = reachable(node);
+    vector<shared_ptr<ExprNode>> built(node + 1);
+    for (Id i = 0; i <= node; ++i) {
+        if (!marks[i]) continue;
+        const Node& n = nodes[i];
+        ExprType type = static_cast<ExprType>(n.type);
+        if (n.type == Type::CONSTANT) {
+            built[i] = ExprNode::make(type, constants[n.left]);
+        } else if (n.type == Type::VARIABLE) {
+            built[i] = ExprNode::make(type, SymbolTable::Symbol(n.left));
+        } else if (n.right != none) {
+            built[i] = ExprNode::make(type, built[n.left], built[n.right]);
+        } else {
+            built[i] = ExprNode::make(type, built[n.left]);
+        }
+    }
+    return Expression<T>(built[node]);
+}
+
+// Явное инстанцирование шаблонов
+template class ExpressionArena<double>;
+template class ExpressionArena<complex<double>>;
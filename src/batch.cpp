@@ -0,0 +1,177 @@
+#include "detail/batch_impl.hpp"
+#include "kernels.hpp"
+
+using namespace std;
+
+namespace batch {
+
+// Каждый регистр - блок из batchBlock значений. Указатель регистра смотрит
+// либо в собственный буфер, либо прямо во входной столбец (для VARIABLE).
+void runReal(const vector<typename CompiledExpression<double>::Instruction>& program,
+             const vector<double>& constants, size_t registers, const vector<uint32_t>& outputs,
+             const vector<const double*>& columns, const vector<double*>& outs, size_t n)
+{
+    using OpCode = typename CompiledExpression<double>::OpCode;
+    constexpr size_t block = CompiledExpression<double>::batchBlock;
+
+    vector<double> storage(registers * block);
+    vector<const double*> reg(registers);
+
+    for (size_t base = 0; base < n; base += block) {
+        size_t m = min(block, n - base);
+        for (const auto& in : program) {
+            if (in.op == OpCode::VARIABLE) {
+                reg[in.dst] = columns[in.lhs] + base;
+                continue;
+            }
+            double* d = &storage[in.dst * block];
+            switch (in.op) {
+                case OpCode::CONSTANT: kernels::fill(constants[in.lhs], d, m); break;
+                case OpCode::VARIABLE: break;
+                case OpCode::ADD: kernels::add(reg[in.lhs], reg[in.rhs], d, m); break;
+                case OpCode::SUBTRACT: kernels::subtract(reg[in.lhs], reg[in.rhs], d, m); break;
+                case OpCode::MULTIPLY: kernels::multiply(reg[in.lhs], reg[in.rhs], d, m); break;
+                case OpCode::DIVIDE: kernels::divide(reg[in.lhs], reg[in.rhs], d, m); break;
+                case OpCode::POWER: kernels::pow(reg[in.lhs], reg[in.rhs], d, m); break;
+                case OpCode::SIN: kernels::sin(reg[in.lhs], d, m); break;
+                case OpCode::COS: kernels::cos(reg[in.lhs], d, m); break;
+                case OpCode::EXP: kernels::exp(reg[in.lhs], d, m); break;
+                case OpCode::LOG: kernels::log(reg[in.lhs], d, m); break;
+                case OpCode::NEGATE: kernels::negate(reg[in.lhs], d, m); break;
+                case OpCode::SQUARE: kernels::square(reg[in.lhs], d, m); break;
+                case OpCode::RECIPROCAL: kernels::reciprocal(reg[in.lhs], d, m); break;
+                case OpCode::SQRT: kernels::sqrt(reg[in.lhs], d, m); break;
+                case OpCode::POWI:
+                    kernels::powi(reg[in.lhs], static_cast<int32_t>(in.rhs), d, m);
+                    break;
+                case OpCode::SINCOS: {
+                    double* c = &storage[in.rhs * block];
+                    kernels::sincos(reg[in.lhs], d, c, m);
+                    reg[in.rhs] = c;
+                    break;
+                }
+                case OpCode::COMPENSATION: kernels::compensation(reg[in.lhs], d, m); break;
+            }
+            reg[in.dst] = d;
+        }
+        for (size_t k = 0; k < outputs.size(); ++k) {
+            copy(reg[outputs[k]], reg[outputs[k]] + m, outs[k] + base);
+        }
+    }
+}
+
+// Комплексный вариант: регистры хранятся как раздельные блоки re и im
+void runComplex(const vector<typename CompiledExpression<complex<double>>::Instruction>& program,
+                const vector<complex<double>>& constants, size_t registers,
+                const vector<uint32_t>& outputs, const vector<const complex<double>*>& columns,
+                const vector<complex<double>*>& outs, size_t n)
+{
+    using OpCode = typename CompiledExpression<complex<double>>::OpCode;
+    constexpr size_t block = CompiledExpression<complex<double>>::batchBlock;
+
+    vector<double> storage(2 * registers * block);
+    auto re = [&](uint32_t r) { return &storage[2 * r * block]; };
+    auto im = [&](uint32_t r) { return &storage[(2 * r + 1) * block]; };
+
+    for (size_t base = 0; base < n; base += block) {
+        size_t m = min(block, n - base);
+        for (const auto& in : program) {
+            double* dr = re(in.dst);
+            double* di = im(in.dst);
+            if (in.op == OpCode::CONSTANT) {
+                kernels::fill(constants[in.lhs].real(), dr, m);
+                kernels::fill(constants[in.lhs].imag(), di, m);
+                continue;
+            }
+            if (in.op == OpCode::VARIABLE) {
+                // std::complex совместим по размещению с double[2]
+                const double* src = reinterpret_cast<const double*>(columns[in.lhs] + base);
+                for (size_t j = 0; j < m; ++j) {
+                    dr[j] = src[2 * j];
+                    di[j] = src[2 * j + 1];
+                }
+                continue;
+            }
+            const double* ar = re(in.lhs);
+            const double* ai = im(in.lhs);
+            // У унарных операций rhs - не регистр (у POWI - показатель)
+            bool binary = in.op >= OpCode::ADD && in.op <= OpCode::POWER;
+            const double* br = binary ? re(in.rhs) : nullptr;
+            const double* bi = binary ? im(in.rhs) : nullptr;
+            switch (in.op) {
+                case OpCode::CONSTANT:
+                case OpCode::VARIABLE:
+                    break;
+                case OpCode::ADD:
+                    kernels::add(ar, br, dr, m);
+                    kernels::add(ai, bi, di, m);
+                    break;
+                case OpCode::SUBTRACT:
+                    kernels::subtract(ar, br, dr, m);
+                    kernels::subtract(ai, bi, di, m);
+                    break;
+                case OpCode::MULTIPLY: kernels::soa::multiply(ar, ai, br, bi, dr, di, m); break;
+                case OpCode::DIVIDE: kernels::soa::divide(ar, ai, br, bi, dr, di, m); break;
+                case OpCode::POWER: kernels::soa::pow(ar, ai, br, bi, dr, di, m); break;
+                case OpCode::SIN: kernels::soa::sin(ar, ai, dr, di, m); break;
+                case OpCode::COS: kernels::soa::cos(ar, ai, dr, di, m); break;
+                case OpCode::EXP: kernels::soa::exp(ar, ai, dr, di, m); break;
+                case OpCode::LOG: kernels::soa::log(ar, ai, dr, di, m); break;
+                case OpCode::NEGATE:
+                    kernels::negate(ar, dr, m);
+                    kernels::negate(ai, di, m);
+                    break;
+                case OpCode::SQUARE: kernels::soa::square(ar, ai, dr, di, m); break;
+                case OpCode::RECIPROCAL: kernels::soa::reciprocal(ar, ai, dr, di, m); break;
+                case OpCode::SQRT: kernels::soa::sqrt(ar, ai, dr, di, m); break;
+                case OpCode::POWI:
+                    kernels::soa::powi(ar, ai, static_cast<int32_t>(in.rhs), dr, di, m);
+                    break;
+                case OpCode::SINCOS:
+                    kernels::soa::sincos(ar, ai, dr, di, re(in.rhs), im(in.rhs), m);
+                    break;
+                case OpCode::COMPENSATION: kernels::soa::compensation(ar, ai, dr, di, m); break;
+            }
+        }
+        for (size_t k = 0; k < outputs.size(); ++k) {
+            double* dst = reinterpret_cast<double*>(outs[k] + base);
+            const double* rr = re(outputs[k]);
+            const double* ri = im(outputs[k]);
+            for (size_t j = 0; j < m; ++j) {
+                dst[2 * j] = rr[j];
+                dst[2 * j + 1] = ri[j];
+            }
+        }
+    }
+}
+
+} // namespace batch
+
+// Явное инстанцирование шаблонов
+template void CompiledExpression<double>::evaluateBatch(
+    const ColumnSet<double>&, double*, size_t) const;
+template void CompiledExpression<complex<double>>::evaluateBatch(
+    const ColumnSet<complex<double>>&, complex<double>*, size_t) const;
+template void CompiledExpression<double>::evaluateBatch(
+    const ColumnSet<double>&, double*, size_t, ThreadPool&, size_t) const;
+template void CompiledExpression<complex<double>>::evaluateBatch(
+    const ColumnSet<complex<double>>&, complex<double>*, size_t, ThreadPool&, size_t) const;
+template void CompiledExpression<double>::evaluateBatch(
+    const ColumnSet<double>&, double*, size_t, size_t) const;
+template void CompiledExpression<complex<double>>::evaluateBatch(
+    const ColumnSet<complex<double>>&, complex<double>*, size_t, size_t) const;
+template void CompiledExpression<double>::evaluateBatchAll(
+    const ColumnSet<double>&, double* const*, size_t) const;
+template void CompiledExpression<complex<double>>::evaluateBatchAll(
+    const ColumnSet<complex<double>>&, complex<double>* const*, size_t) const;
+template void CompiledExpression<double>::evaluateBatchAll(
+    const ColumnSet<double>&, double* const*, size_t, ThreadPool&, size_t) const;
+template void CompiledExpression<complex<double>>::evaluateBatchAll(
+    const ColumnSet<complex<double>>&, complex<double>* const*, size_t, ThreadPool&, size_t) const;
+template void Expression<double>::evaluateBatch(const ColumnSet<double>&, double*, size_t) const;
+template void Expression<complex<double>>::evaluateBatch(
+    const ColumnSet<complex<double>>&, complex<double>*, size_t) const;
+template void Expression<double>::evaluateBatch(
+    const ColumnSet<double>&, double*, size_t, ThreadPool&, size_t) const;
+template void Expression<complex<double>>::evaluateBatch(
+    const ColumnSet<complex<double>>&, complex<double>*, size_t, ThreadPool&, size_t) const;
@@ -0,0 +1,266 @@
+#include "expression.hpp"
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Набор замеров: make bench печатает результаты в JSON в формате Google
+// Benchmark (context + benchmarks), чтобы их можно было сравнивать между
+// версиями теми же средствами.
+//
+//   ./expression_bench [--filter подстрока] [--min-time секунды]
+//
+// Каждый замер калибрует число повторений так, чтобы один прогон шёл не
+// меньше min-time, делает пять прогонов и сообщает медиану и минимум.
+
+#ifndef EXPRESSION_BENCH_MODE
+#define EXPRESSION_BENCH_MODE "unknown"
+#endif
+
+namespace {
+
+// Не даёт компилятору выбросить вычисление результата
+template <typename T>
+void keep(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct Result {
+    string name;
+    size_t iterations;
+    double median;
+    double best;
+    // Дополнительные счётчики: число узлов, строк в секунду и т. п.
+    vector<pair<string, double>> counters;
+};
+
+struct Options {
+    string filter;
+    double minTime = 0.1;
+};
+
+class Suite {
+public:
+    explicit Suite(Options options) : options(move(options)) {}
+
+    // body выполняет одну операцию; counters заполняются один раз после замера
+    void run(const string& name, const function<void()>& body,
+             vector<pair<string, double>> counters = {}) {
+        if (!options.filter.empty() && name.find(options.filter) == string::npos) return;
+        using Clock = chrono::steady_clock;
+        auto measure = [&](size_t iterations) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i) body();
+            return chrono::duration<double>(Clock::now() - start).count();
+        };
+        size_t iterations = 1;
+        double elapsed = measure(iterations);
+        while (elapsed < options.minTime && iterations < (size_t(1) << 40)) {
+            double scale = elapsed > 0 ? options.minTime / elapsed * 1.2 : 10;
+            iterations = max(iterations + 1, static_cast<size_t>(iterations * min(scale, 10.0)));
+            elapsed = measure(iterations);
+        }
+        vector<double> samples;
+        for (int k = 0; k < 5; ++k) samples.push_back(measure(iterations) / iterations * 1e9);
+        sort(samples.begin(), samples.end());
+        results.push_back({name, iterations, samples[2], samples[0], move(counters)});
+        cerr << name << ": " << samples[2] << " ns" << endl;
+    }
+
+    void print(ostream& out) const {
+        out << "{\n  \"context\": {\n"
+            << "    \"library\": \"expression\",\n"
+            << "    \"build\": \"" << EXPRESSION_BENCH_MODE << "\",\n"
+            << "    \"min_time\": " << options.minTime << "\n  },\n"
+            << "  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"iterations\": "
+                << r.iterations << ", \"real_time\": " << number(r.median)
+                << ", \"min_time\": " << number(r.best) << ", \"time_unit\": \"ns\"";
+            for (const auto& [key, value] : r.counters) out << ", \"" << key << "\": " << number(value);
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    Options options;
+    vector<Result> results;
+
+    static string number(double value) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+};
+
+template <typename T>
+const char* scalarName();
+
+template <>
+const char* scalarName<double>() { return "double"; }
+
+template <>
+const char* scalarName<complex<double>>() { return "complex"; }
+
+// Левосторонняя цепочка глубины depth: ((x + sin(x * c1)) + sin(x * c2)) + ...
+template <typename T>
+Expression<T> chain(size_t depth) {
+    Expression<T> x("x");
+    Expression<T> result = x;
+    for (size_t k = 1; k <= depth; ++k) result += sin(x * Expression<T>(T(1.0 / double(k))));
+    return result;
+}
+
+// Сбалансированное дерево из width листьев: попарные произведения и суммы
+template <typename T>
+Expression<T> balanced(size_t width) {
+    Expression<T> x("x");
+    vector<Expression<T>> level;
+    for (size_t k = 0; k < width; ++k) level.push_back(x + Expression<T>(T(double(k) / double(width))));
+    bool multiply = true;
+    while (level.size() > 1) {
+        vector<Expression<T>> next;
+        for (size_t i = 0; i + 1 < level.size(); i += 2)
+            next.push_back(multiply ? level[i] * level[i + 1] : level[i] + level[i + 1]);
+        if (level.size() % 2) next.push_back(level.back());
+        level.swap(next);
+        multiply = !multiply;
+    }
+    return level.front();
+}
+
+// Число различных узлов: у программы по инструкции на каждый узел после слияния
+template <typename T>
+size_t nodeCount(const Expression<T>& expr) {
+    return expr.compile().instructions().size();
+}
+
+template <typename T>
+void shapes(Suite& suite) {
+    string type = scalarName<T>();
+    map<string, T> vars{{"x", T(0.75)}};
+    for (size_t depth : {10, 100, 1000, 10000}) {
+        auto expr = chain<T>(depth);
+        auto compiled = expr.compile();
+        string suffix = "/" + type + "/" + to_string(depth);
+        double nodes = double(nodeCount(expr));
+        suite.run("evaluate/depth" + suffix, [&] { keep(expr.evaluate(vars)); },
+                  {{"nodes", nodes}});
+        suite.run("compiled/depth" + suffix, [&] { keep(compiled.evaluate(vars)); },
+                  {{"nodes", nodes}});
+    }
+    for (size_t width : {16, 256, 4096}) {
+        auto expr = balanced<T>(width);
+        auto compiled = expr.compile();
+        string suffix = "/" + type + "/" + to_string(width);
+        double nodes = double(nodeCount(expr));
+        suite.run("evaluate/width" + suffix, [&] { keep(expr.evaluate(vars)); },
+                  {{"nodes", nodes}});
+        suite.run("compiled/width" + suffix, [&] { keep(compiled.evaluate(vars)); },
+                  {{"nodes", nodes}});
+    }
+}
+
+// Число переменных: дерево ищет каждую в std::map, программа берёт по слоту
+template <typename T>
+void variables(Suite& suite) {
+    string type = scalarName<T>();
+    for (size_t count : {1, 4, 16, 64}) {
+        vector<string> names;
+        map<string, T> vars;
+        vector<T> values;
+        Expression<T> expr(T(0));
+        for (size_t i = 0; i < count; ++i) {
+            names.push_back("v" + to_string(i));
+            vars[names.back()] = T(1.0 + double(i) / double(count));
+            values.push_back(vars[names.back()]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            expr += Expression<T>(names[i]) * Expression<T>(names[(i + 1) % count]);
+        }
+        auto bound = expr.bind(names);
+        string suffix = "/" + type + "/" + to_string(count);
+        suite.run("variables/map" + suffix, [&] { keep(expr.evaluate(vars)); });
+        suite.run("variables/compiled-map" + suffix, [&] { keep(bound.evaluate(vars)); });
+        suite.run("variables/compiled-slots" + suffix, [&] { keep(bound.evaluate(values.data())); });
+    }
+}
+
+template <typename T>
+void transforms(Suite& suite) {
+    string type = scalarName<T>();
+    Expression<T> y("y");
+    for (size_t depth : {100, 1000, 10000}) {
+        auto expr = chain<T>(depth);
+        string suffix = "/" + type + "/" + to_string(depth);
+        double nodes = double(nodeCount(expr));
+        double derivativeNodes = double(nodeCount(expr.derivative("x")));
+        double simplifiedNodes = double(nodeCount(expr.derivative("x", true)));
+        suite.run("derivative" + suffix, [&] { keep(expr.derivative("x")); },
+                  {{"nodes", nodes}, {"output_nodes", derivativeNodes}});
+        suite.run("derivative-simplified" + suffix, [&] { keep(expr.derivative("x", true)); },
+                  {{"nodes", nodes}, {"output_nodes", simplifiedNodes}});
+        suite.run("substitute" + suffix, [&] { keep(expr.substitute("x", y * y)); },
+                  {{"nodes", nodes}});
+        suite.run("toString" + suffix, [&] { keep(expr.toString()); },
+                  {{"nodes", nodes}, {"chars", double(expr.toString().size())}});
+        suite.run("compile" + suffix, [&] { keep(expr.compile()); }, {{"nodes", nodes}});
+    }
+}
+
+template <typename T>
+void batch(Suite& suite) {
+    string type = scalarName<T>();
+    auto compiled = chain<T>(100).compile();
+    const size_t rows = 4096;
+    vector<T> xs(rows), out(rows);
+    for (size_t i = 0; i < rows; ++i) xs[i] = T(double(i) / double(rows));
+    ColumnSet<T> inputs{{"x", xs.data()}};
+    suite.run("batch/" + type + "/" + to_string(rows),
+              [&] { compiled.evaluateBatch(inputs, out.data(), rows); keep(out[0]); },
+              {{"rows", double(rows)}});
+}
+
+template <typename T>
+void all(Suite& suite) {
+    shapes<T>(suite);
+    variables<T>(suite);
+    transforms<T>(suite);
+    batch<T>(suite);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.minTime = atof(argv[++i]);
+        } else {
+            cerr << "usage: " << argv[0] << " [--filter substring] [--min-time seconds]" << endl;
+            return 1;
+        }
+    }
+    Suite suite(options);
+    all<double>(suite);
+    all<complex<double>>(suite);
+    suite.print(cout);
+    return 0;
+}
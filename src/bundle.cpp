@@ -0,0 +1,41 @@
+#include "expression_bundle.hpp"
+
+using namespace std;
+
+// Построение набора
+template <typename T>
+ExpressionBundle<T>::ExpressionBundle(vector<Expression<T>> expressions)
+    : expressions(move(expressions)), compiled(Expression<T>::compile(this->expressions)) {}
+
+template <typename T>
+ExpressionBundle<T>::ExpressionBundle(vector<Expression<T>> expressions,
+                                      const vector<string>& variables)
+    : expressions(move(expressions)),
+      compiled(Expression<T>::bind(this->expressions, variables)) {}
+
+// Вычисление всех выражений
+template <typename T>
+vector<T> ExpressionBundle<T>::evaluate(const map<string, T>& variables) const {
+    return compiled.evaluateAll(variables);
+}
+
+template <typename T>
+void ExpressionBundle<T>::evaluate(const T* values, T* out) const {
+    compiled.evaluateAll(values, out);
+}
+
+template <typename T>
+void ExpressionBundle<T>::evaluateBatch(const ColumnSet<T>& inputs, T* const* outs,
+                                        size_t n) const {
+    compiled.evaluateBatchAll(inputs, outs, n);
+}
+
+template <typename T>
+void ExpressionBundle<T>::evaluateBatch(const ColumnSet<T>& inputs, T* const* outs, size_t n,
+                                        ThreadPool& pool, size_t threads) const {
+    compiled.evaluateBatchAll(inputs, outs, n, pool, threads);
+}
+
+// Явное инстанцирование шаблонов
+template class ExpressionBundle<double>;
+template class ExpressionBundle<complex<double>>;
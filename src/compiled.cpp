@@ -0,0 +1,26 @@
+#include "detail/compiled_impl.hpp"
+
+using namespace std;
+
+// Явное инстанцирование шаблонов
+template class CompiledExpression<double>;
+template class CompiledExpression<complex<double>>;
+template CompiledExpression<double> Expression<double>::compile() const;
+template CompiledExpression<complex<double>> Expression<complex<double>>::compile() const;
+template CompiledExpression<double> Expression<double>::bind(const vector<string>&) const;
+template CompiledExpression<complex<double>> Expression<complex<double>>::bind(
+    const vector<string>&) const;
+template CompiledExpression<double> Expression<double>::compile(const vector<string>*) const;
+template CompiledExpression<complex<double>> Expression<complex<double>>::compile(
+    const vector<string>*) const;
+template CompiledExpression<double> Expression<double>::compile(const vector<Expression<double>>&);
+template CompiledExpression<complex<double>> Expression<complex<double>>::compile(
+    const vector<Expression<complex<double>>>&);
+template CompiledExpression<double> Expression<double>::bind(const vector<Expression<double>>&,
+                                                             const vector<string>&);
+template CompiledExpression<complex<double>> Expression<complex<double>>::bind(
+    const vector<Expression<complex<double>>>&, const vector<string>&);
+template CompiledExpression<double> Expression<double>::compile(
+    const vector<Expression<double>>&, const vector<string>*);
+template CompiledExpression<complex<double>> Expression<complex<double>>::compile(
+    const vector<Expression<complex<double>>>&, const vector<string>*);
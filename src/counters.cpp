@@ -0,0 +1,79 @@
+#include "detail/counters.hpp"
+#include <array>
+#include <atomic>
+
+using namespace std;
+
+namespace {
+
+using Operation = ExpressionCounters::Operation;
+
+struct Slot {
+    atomic<uint64_t> calls{0};
+    atomic<uint64_t> nanoseconds{0};
+    atomic<uint64_t> allocations{0};
+};
+
+array<Slot, ExpressionCounters::operationCount>& slots() {
+    // Не разрушается при выходе: замеры идут и из деструкторов статических объектов
+    static auto* s = new array<Slot, ExpressionCounters::operationCount>;
+    return *s;
+}
+
+const char* const names[ExpressionCounters::operationCount] = {
+    "evaluate", "compiled_evaluate", "batch", "derivative", "substitute", "simplify", "compile"
+};
+
+} // namespace
+
+// Единственное место, где действует EXPRESSION_COUNTERS
+#ifdef EXPRESSION_COUNTERS
+const bool counters::active = true;
+#else
+const bool counters::active = false;
+#endif
+
+void counters::record(Operation operation, uint64_t nanoseconds, uint64_t allocations) {
+    Slot& slot = slots()[static_cast<size_t>(operation)];
+    slot.calls.fetch_add(1, memory_order_relaxed);
+    slot.nanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+    slot.allocations.fetch_add(allocations, memory_order_relaxed);
+}
+
+bool ExpressionCounters::enabled() {
+    return counters::active;
+}
+
+ExpressionCounters::Counters ExpressionCounters::get(Operation operation) {
+    const Slot& slot = slots()[static_cast<size_t>(operation)];
+    Counters counters;
+    counters.calls = slot.calls.load(memory_order_relaxed);
+    counters.nanoseconds = slot.nanoseconds.load(memory_order_relaxed);
+    counters.allocations = slot.allocations.load(memory_order_relaxed);
+    return counters;
+}
+
+const char* ExpressionCounters::name(Operation operation) {
+    return names[static_cast<size_t>(operation)];
+}
+
+vector<pair<string, uint64_t>> ExpressionCounters::snapshot() {
+    vector<pair<string, uint64_t>> metrics;
+    metrics.reserve(operationCount * 3);
+    for (size_t i = 0; i < operationCount; ++i) {
+        string prefix = string("expression.") + names[i] + ".";
+        Counters counters = get(static_cast<Operation>(i));
+        metrics.emplace_back(prefix + "calls", counters.calls);
+        metrics.emplace_back(prefix + "nanoseconds", counters.nanoseconds);
+        metrics.emplace_back(prefix + "allocations", counters.allocations);
+    }
+    return metrics;
+}
+
+void ExpressionCounters::reset() {
+    for (Slot& slot : slots()) {
+        slot.calls.store(0, memory_order_relaxed);
+        slot.nanoseconds.store(0, memory_order_relaxed);
+        slot.allocations.store(0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,19 @@
+#include "detail/dual_impl.hpp"
+
+using namespace std;
+
+// Явное инстанцирование шаблонов
+template Dual<double> Expression<double>::evaluateDual(const string&, const map<string, double>&) const;
+template Dual<complex<double>> Expression<complex<double>>::evaluateDual(
+    const string&, const map<string, complex<double>>&) const;
+template Dual<double> Expression<double>::evaluateDirectional(
+    const map<string, double>&, const map<string, double>&) const;
+template Dual<complex<double>> Expression<complex<double>>::evaluateDirectional(
+    const map<string, complex<double>>&, const map<string, complex<double>>&) const;
+template Dual<double> CompiledExpression<double>::evaluateDual(const double*, const double*) const;
+template Dual<complex<double>> CompiledExpression<complex<double>>::evaluateDual(
+    const complex<double>*, const complex<double>*) const;
+template Dual<double> CompiledExpression<double>::evaluateDual(
+    const double*, const double*, Dual<double>*) const;
+template Dual<complex<double>> CompiledExpression<complex<double>>::evaluateDual(
+    const complex<double>*, const complex<double>*, Dual<complex<double>>*) const;
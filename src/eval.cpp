@@ -1,6 +1,20 @@
 #include "expression.hpp"
+#include "expression_arena.hpp"
+#include "expression_bundle.hpp"
+#include "expression_counters.hpp"
+#include "expression_ct.hpp"
+#include "expression_image.hpp"
+#include "expression_impl.hpp"
+#include "expression_incremental.hpp"
+#include "expression_interval.hpp"
+#include "thread_pool.hpp"
 #include <iostream>
 #include <complex>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include <chrono>
 
 using namespace std;
 
@@ -12,11 +26,198 @@ int main() {
     
     auto df = f.derivative("x");
     cout << "f'(x) = " << df.toString() << endl;
+    cout << "simplified f'(x) = " << f.derivative("x", true).toString() << endl;
     
     map<string, double> vars = {{"x", 1.5}};
     cout << "f(1.5) = " << f.evaluate(vars) << endl;
     cout << "f'(1.5) = " << df.evaluate(vars) << endl;
     
+    // Повторные производные через общий кэш: f'' использует уже найденные узлы f'
+    DerivativeContext<double> context;
+    auto ddf = f.derivative("x", context).derivative("x", context, true);
+    cout << "f''(x) = " << ddf.toString() << ", cached nodes = " << context.size() << endl;
+    
+    auto compiled = df.compile();
+    cout << "compiled f'(1.5) = " << compiled.evaluate(vars) << endl;
+    
+    auto bound = df.bind({"x"});
+    double x0 = 1.5;
+    cout << "bound f'(1.5) = " << bound.evaluate(&x0) << endl;
+    
+    vector<double> xs = {0.5, 1.0, 1.5, 2.0};
+    vector<double> ys(xs.size());
+    bound.evaluateBatch({{"x", xs.data()}}, ys.data(), xs.size());
+    cout << "batch f'(x) =";
+    for (double y : ys) cout << " " << y;
+    cout << endl;
+    
+    // Миллион строк на пуле из четырёх потоков: результат совпадает с однопоточным
+    const size_t rows = 1000000;
+    vector<double> manyX(rows), serial(rows), parallel(rows);
+    for (size_t i = 0; i < rows; ++i) manyX[i] = 1e-5 * double(i);
+    ThreadPool pool(4);
+    bound.evaluateBatch({{"x", manyX.data()}}, serial.data(), rows);
+    bound.evaluateBatch({{"x", manyX.data()}}, parallel.data(), rows, pool);
+    cout << "parallel batch of " << rows << " rows on " << pool.size() << " threads: "
+         << (serial == parallel ? "matches" : "differs from") << " serial" << endl;
+    
+    Expression<double> y("y");
+    auto h = x * y + sin(x) / y;
+    auto grad = h.gradient({"x", "y"}, {{"x", 1.5}, {"y", 2.0}});
+    cout << "h(x, y) = " << h.toString() << ", grad h(1.5, 2) = ("
+         << grad[0] << ", " << grad[1] << ")" << endl;
+    // Одновременная подстановка: x и y меняются местами за один обход
+    auto swapped = h.substitute({{"x", y}, {"y", x}});
+    cout << "h(y, x) = " << swapped.toString() << endl;
+    // Показатель с переменной: (x^y)' по x и по y
+    auto power = pow(x, y);
+    cout << "d/dx x^y = " << power.derivative("x", true).toString()
+         << ", d/dy x^y = " << power.derivative("y", true).toString() << endl;
+    // Пакетная x^y против std::pow при |y log x| до 700: ошибка логарифма
+    // умножается на y, поэтому проверка идёт по всему диапазону показателей
+    const size_t powRows = 100000;
+    vector<double> bases(powRows), exponents(powRows), powers(powRows);
+    mt19937_64 random(2024);
+    uniform_real_distribution<double> logBase(-20.0, 20.0), scale(-700.0, 700.0);
+    for (size_t i = 0; i < powRows; ++i) {
+        bases[i] = exp(logBase(random));
+        exponents[i] = scale(random) / max(fabs(log(bases[i])), 1e-3);
+        // Отрицательные основания с целыми показателями
+        if (i % 4 == 0) {
+            bases[i] = -bases[i];
+            exponents[i] = round(exponents[i]);
+        }
+    }
+    power.bind({"x", "y"}).evaluateBatch({{"x", bases.data()}, {"y", exponents.data()}},
+                                         powers.data(), powRows);
+    double worstPow = 0.0;
+    for (size_t i = 0; i < powRows; ++i) {
+        double exact = pow(bases[i], exponents[i]);
+        if (!isfinite(exact) || exact == 0.0) continue;
+        double ulp = nextafter(fabs(exact), numeric_limits<double>::infinity()) - fabs(exact);
+        worstPow = max(worstPow, fabs(powers[i] - exact) / ulp);
+    }
+    cout << "batch x^y for |y log x| <= 700: max error " << worstPow << " ulp" << endl;
+    if (worstPow > 2.0) return 1;
+    // sin(x) и cos(x) из производной вычисляются одной инструкцией SINCOS
+    auto wave = sin(x) * cos(x);
+    auto waveProgram = wave.derivative("x").compile();
+    size_t fusedTrig = 0;
+    for (const auto& in : waveProgram.instructions())
+        fusedTrig += in.op == CompiledExpression<double>::OpCode::SINCOS;
+    cout << "(sin x cos x)' compiles to " << waveProgram.instructions().size()
+         << " instructions, " << fusedTrig << " sincos" << endl;
+    // Границы h на боксе x в [1, 2], y в [2, 3] без вычислений в точках
+    Interval range = IntervalExpression(h).evaluate({{"x", {1.0, 2.0}}, {"y", {2.0, 3.0}}});
+    cout << "h over [1, 2] x [2, 3] lies in [" << range.lo << ", " << range.hi << "]" << endl;
+    
+    // f, f' и f'' одной программой: общие узлы считаются один раз
+    ExpressionBundle<double> bundle({f, df, df.derivative("x")}, {"x"});
+    auto together = bundle.evaluate(vars);
+    cout << "bundle at 1.5 = " << together[0] << ", " << together[1] << ", " << together[2]
+         << " (" << bundle.program().instructions().size() << " instructions)" << endl;
+    
+    // После изменения y пересчитываются только узлы, зависящие от y; sin(x) берётся из кэша
+    IncrementalEvaluator<double> incremental(h, {{"x", 1.5}, {"y", 2.0}});
+    double before = incremental.result();
+    incremental.set("y", 4.0);
+    double after = incremental.result();
+    cout << "incremental h = " << before << " -> " << after << ", recomputed "
+         << incremental.recomputed() << " nodes" << endl;
+    
+    // Гессиан h одной программой с четырьмя выходами
+    auto hess = Expression<double>::bind(h.hessian({"x", "y"}), {"x", "y"});
+    double point[] = {1.5, 2.0};
+    double hessValues[4];
+    hess.evaluateAll(point, hessValues);
+    cout << "hess h(1.5, 2) = [" << hessValues[0] << ", " << hessValues[1] << "; "
+         << hessValues[2] << ", " << hessValues[3] << "], "
+         << hess.instructions().size() << " instructions" << endl;
+    
+    // Формула, известная при компиляции: вычисление и производная без узлов
+    constexpr auto cx = ct::variable<0>;
+    constexpr auto cy = ct::variable<1>;
+    constexpr auto poly = cx * cx + 2.0 * cx * cy;
+    static_assert(poly.derivative<0>()(1.5, 2.0) == 7.0, "d/dx (x^2 + 2xy) = 2x + 2y");
+    auto ch = cx * cx + ct::sin(cx) * cy;
+    cout << "ct h(1.5, 2) = " << ch(1.5, 2.0) << ", dh/dx = " << ch.derivative<0>()(1.5, 2.0)
+         << ", as Expression: " << ch.toExpression<double>({"x", "y"}).toString() << endl;
+    
+    auto dual = pow(x, y).evaluateDual("y", {{"x", 1.5}, {"y", 2.0}});
+    cout << "d/dy pow(x, y) at (1.5, 2) = " << dual.derivative
+         << ", value = " << dual.value << endl;
+    
+    ExpressionArena<double> arena;
+    auto fa = arena.import(f);
+    auto dfa = arena.derivative(fa, "x");
+    cout << "arena f'(x) = " << arena.toExpression(dfa).toString()
+         << ", f'(1.5) = " << arena.evaluate(dfa, vars)
+         << ", nodes = " << arena.size() << endl;
+    arena.clear();
+    
+    // Разбор строки обратно в выражение
+    auto parsed = Expression<double>::parse(f.toString());
+    cout << "minimal f'(x) = " << df.toString(Parentheses::MINIMAL) << endl;
+    cout << "parsed f(x) = " << parsed.toString() << ", f(1.5) = " << parsed.evaluate(vars) << endl;
+    cout << "parse(\"x*x + 2*x - 1\") at 1.5 = "
+         << Expression<double>::parse("x*x + 2*x - 1").evaluate(vars) << endl;
+    
+    // Двоичный образ f и f': общие подвыражения записаны один раз
+    auto bytes = Expression<double>::serialize({f, df});
+    ExpressionImage<double> image(bytes.data(), bytes.size());
+    cout << "image: " << image.size() << " expressions, " << bytes.size() << " bytes"
+         << ", f'(1.5) = " << image.evaluate(1, vars)
+         << ", restored f(x) = " << Expression<double>::deserialize(bytes.data(), bytes.size()).toString()
+         << endl;
+    
+    // Глубокое дерево: сумма из 10^5 слагаемых, построенная в цикле
+    const int terms = 100000;
+    auto start = chrono::steady_clock::now();
+    Expression<double> deep(0.0);
+    for (int k = 1; k <= terms; ++k) {
+        deep += sin(x * Expression<double>(1.0 / k));
+    }
+    double deepValue = deep.evaluate(vars);
+    auto deepDerivative = deep.derivative("x");
+    double deepSlope = deepDerivative.evaluate(vars);
+    size_t deepLength = deep.toString().size();
+    double compiledSlope = deepDerivative.compile().evaluate(vars);
+    auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start);
+    cout << "deep sum of " << terms << " terms: f(1.5) = " << deepValue
+         << ", f'(1.5) = " << deepSlope << " (compiled " << compiledSlope << ")"
+         << ", " << deepLength << " chars, " << elapsed.count() << " ms" << endl;
+    
+    // Та же сумма одним n-арным узлом, обычная и компенсированная
+    vector<Expression<double>> parts;
+    parts.reserve(terms);
+    for (int k = 1; k <= terms; ++k) parts.push_back(sin(x * Expression<double>(1.0 / k)));
+    auto nary = Expression<double>::sum(parts);
+    auto compensated = Expression<double>::sum(parts, Summation::COMPENSATED);
+    cout << "n-ary sum: f(1.5) = " << nary.evaluate(vars)
+         << ", f'(1.5) = " << nary.derivative("x").evaluate(vars)
+         << ", compensated f(1.5) = " << compensated.compile().evaluate(vars) << endl;
+    // Бесконечное слагаемое: поправка Кахана не превращает сумму в NaN
+    Expression<double> infinity(numeric_limits<double>::infinity());
+    auto infinite = Expression<double>::sum({x, infinity, Expression<double>(1.0), x},
+                                            Summation::COMPENSATED);
+    double infiniteBatch[1];
+    infinite.compile().evaluateBatch({{"x", &x0}}, infiniteBatch, 1);
+    cout << "compensated x + inf + 1 + x: tree " << infinite.evaluate(vars)
+         << ", compiled " << infinite.compile().evaluate(vars)
+         << ", batch " << infiniteBatch[0] << endl;
+    
+    // Форма выражения: дерево против DAG, глубина и оценка памяти
+    ExpressionStats deepStats = deepDerivative.stats();
+    cout << "stats of f': " << deepStats.treeNodes << " tree nodes, " << deepStats.uniqueNodes
+         << " unique, depth " << deepStats.depth << ", ~" << deepStats.bytes / 1024 << " KiB, types:";
+    for (const auto& [type, count] : deepStats.types) cout << " " << type << "=" << count;
+    cout << endl;
+    if (ExpressionCounters::enabled()) {
+        for (const auto& [metric, value] : ExpressionCounters::snapshot()) {
+            if (value) cout << metric << " = " << value << endl;
+        }
+    }
+    
     Expression<complex<double>> z("z");
     auto g = exp(z) + pow(z, complex<double>(2.0, 0.0));
     
@@ -24,10 +225,19 @@ int main() {
     
     auto dg = g.derivative("z");
     cout << "g'(z) = " << dg.toString() << endl;
+    cout << "simplified g'(z) = " << dg.simplify().toString() << endl;
     
     map<string, complex<double>> cvars = {{"z", complex<double>(1.0, 1.0)}};
     cout << "g(1+i) = " << g.evaluate(cvars) << endl;
     cout << "g'(1+i) = " << dg.evaluate(cvars) << endl;
+    cout << "compiled g'(1+i) = " << dg.compile().evaluate(cvars) << endl;
+    
+    // float не собран в библиотеке: шаблоны инстанцируются из expression_impl.hpp
+    Expression<float> xf("x");
+    auto ff = pow(xf, 2.0f) + sin(xf);
+    auto dff = ff.derivative("x", true);
+    cout << "\nfloat f'(x) = " << dff.toString() << ", f'(1.5) = "
+         << dff.compile().evaluate({{"x", 1.5f}}) << endl;
     
     return 0;
 }
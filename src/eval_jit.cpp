@@ -0,0 +1,43 @@
+#include "expression.hpp"
+#include "expression_jit.hpp"
+#include <iostream>
+#include <complex>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+int main() {
+    Expression<double> x("x");
+    Expression<double> y("y");
+    auto f = pow(x, 2.0) + sin(x) * y - exp(-x) / y;
+    
+    JitExpression<double> jit(f);
+    cout << "f(x, y) = " << f.toString() << endl;
+    cout << "variables:";
+    for (const string& name : jit.variables()) cout << " " << name;
+    cout << ", " << jit.codeSize() << " bytes of code" << endl;
+    
+    map<string, double> vars = {{"x", 1.5}, {"y", 2.0}};
+    double values[] = {1.5, 2.0};
+    cout << "f(1.5, 2) = " << f.evaluate(vars) << endl;
+    cout << "jit f(1.5, 2) = " << jit(values) << endl;
+    
+    JitExpression<double> df(f.derivative("x"));
+    cout << "jit f'(1.5, 2) = " << df.evaluate(vars) << endl;
+    
+    // Бесконечное слагаемое компенсированной суммы даёт inf, а не NaN
+    auto infinite = Expression<double>::sum(
+        {x, Expression<double>(numeric_limits<double>::infinity()), y, x}, Summation::COMPENSATED);
+    cout << "jit compensated x + inf + y + x = " << JitExpression<double>(infinite)(values) << endl;
+    
+    Expression<complex<double>> z("z");
+    auto g = exp(z) + pow(z, complex<double>(2.0, 0.0)) * z;
+    JitExpression<complex<double>> cjit(g);
+    complex<double> point(1.0, 1.0);
+    cout << "\ng(z) = " << g.toString() << endl;
+    cout << "g(1+i) = " << g.evaluate({{"z", point}}) << endl;
+    cout << "jit g(1+i) = " << cjit(&point) << endl;
+    
+    return 0;
+}
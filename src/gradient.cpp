@@ -0,0 +1,15 @@
+#include "detail/gradient_impl.hpp"
+
+using namespace std;
+
+// Явное инстанцирование шаблонов
+template double CompiledExpression<double>::gradient(const double*, double*) const;
+template complex<double> CompiledExpression<complex<double>>::gradient(
+    const complex<double>*, complex<double>*) const;
+template vector<double> CompiledExpression<double>::gradient(const map<string, double>&) const;
+template vector<complex<double>> CompiledExpression<complex<double>>::gradient(
+    const map<string, complex<double>>&) const;
+template vector<double> Expression<double>::gradient(const vector<string>&,
+                                                     const map<string, double>&) const;
+template vector<complex<double>> Expression<complex<double>>::gradient(
+    const vector<string>&, const map<string, complex<double>>&) const;
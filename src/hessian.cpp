@@ -0,0 +1,13 @@
+#include "detail/hessian_impl.hpp"
+
+using namespace std;
+
+// Явное инстанцирование шаблонов
+template vector<Expression<double>> Expression<double>::jacobian(
+    const vector<Expression<double>>&, const vector<string>&, bool);
+template vector<Expression<complex<double>>> Expression<complex<double>>::jacobian(
+    const vector<Expression<complex<double>>>&, const vector<string>&, bool);
+template vector<Expression<double>> Expression<double>::hessian(const vector<string>&,
+                                                                bool) const;
+template vector<Expression<complex<double>>> Expression<complex<double>>::hessian(
+    const vector<string>&, bool) const;
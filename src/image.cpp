@@ -0,0 +1,464 @@
+#include "expression_image.hpp"
+#include "detail/node.hpp"
+#include "detail/power.hpp"
+#include "detail/symbols.hpp"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define EXPRESSION_IMAGE_MMAP 1
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr char imageMagic[4] = {'E', 'X', 'P', 'R'};
+constexpr uint32_t imageByteOrder = 0x01020304;
+// Последний бинарный, последний унарный и последний n-арный коды типов узлов
+constexpr uint8_t lastBinary = 6;
+constexpr uint8_t lastUnary = 11;
+constexpr uint8_t lastType = 14;
+
+template <typename T>
+constexpr uint8_t scalarCode() {
+    return is_same_v<T, double> ? 0 : 1;
+}
+
+// Смещения секций образа по заголовку
+struct Layout {
+    uint64_t constants;
+    uint64_t nodes;
+    uint64_t operands;
+    uint64_t roots;
+    uint64_t offsets;
+    uint64_t names;
+    uint64_t size;
+};
+
+template <typename T>
+Layout layoutOf(const typename ExpressionImage<T>::Header& header) {
+    using Image = ExpressionImage<T>;
+    Layout layout;
+    layout.constants = sizeof(typename Image::Header);
+    layout.nodes = layout.constants + uint64_t(header.constantCount) * sizeof(T);
+    layout.operands = layout.nodes + uint64_t(header.nodeCount) * sizeof(typename Image::Node);
+    layout.roots = layout.operands + uint64_t(header.operandCount) * sizeof(typename Image::Id);
+    layout.offsets = layout.roots + uint64_t(header.rootCount) * sizeof(typename Image::Id);
+    layout.names = layout.offsets + (uint64_t(header.symbolCount) + 1) * sizeof(uint32_t);
+    layout.size = layout.names + header.nameBytes;
+    return layout;
+}
+
+// constantExponent: показатель POWER - узел CONSTANT, и степень считается
+// так же, как в остальных вычислителях
+template <typename Type, typename T>
+T apply(Type type, const T& a, const T& b, bool constantExponent) {
+    switch (type) {
+        case Type::ADD: return a + b;
+        case Type::SUBTRACT: return a - b;
+        case Type::MULTIPLY: return a * b;
+        case Type::DIVIDE: return a / b;
+        case Type::POWER: return constantExponent ? power::constant(a, b) : std::pow(a, b);
+        case Type::SIN: return std::sin(a);
+        case Type::COS: return std::cos(a);
+        case Type::EXP: return std::exp(a);
+        case Type::LOG: return std::log(a);
+        case Type::NEGATE: return -a;
+        case Type::SUM:
+        case Type::COMPENSATED_SUM:
+        case Type::PRODUCT:
+        case Type::CONSTANT:
+        case Type::VARIABLE:
+            break;
+    }
+    return T(0);
+}
+
+} // namespace
+
+// Запись образа
+template <typename T>
+vector<unsigned char> Expression<T>::serialize() const {
+    return serialize(vector<Expression>{*this});
+}
+
+template <typename T>
+vector<unsigned char> Expression<T>::serialize(const vector<Expression>& expressions) {
+    using Image = ExpressionImage<T>;
+    using Id = typename Image::Id;
+    static_assert(sizeof(typename Image::Header) == 48, "image header layout");
+    static_assert(sizeof(typename Image::Node) == 12, "image node layout");
+
+    // Узлы нумеруются в обратном обходе, поэтому потомок получает номер раньше родителя
+    unordered_map<const Node*, Id> index;
+    unordered_map<SymbolTable::Symbol, uint32_t> symbols;
+    vector<typename Image::Node> nodes;
+    vector<Id> operands;
+    vector<uint32_t> parents;
+    vector<T> constants;
+    vector<Id> roots;
+    string names;
+    vector<uint32_t> offsets{0};
+
+    struct Frame {
+        const Node* node;
+        bool expanded;
+    };
+    vector<Frame> stack;
+    for (const Expression& expr : expressions) {
+        stack.push_back({expr.root.get(), false});
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            const Node* node = frame.node;
+            if (index.count(node)) {
+                stack.pop_back();
+                continue;
+            }
+            if (node->arity() && !frame.expanded) {
+                frame.expanded = true;
+                for (size_t k = node->arity(); k-- > 0;) stack.push_back({node->child(k).get(), false});
+                continue;
+            }
+            stack.pop_back();
+
+            typename Image::Node entry{static_cast<uint8_t>(node->type), 0, 0, Image::none, Image::none};
+            if (node->type == Node::Type::CONSTANT) {
+                entry.left = static_cast<Id>(constants.size());
+                constants.push_back(node->value);
+            } else if (node->type == Node::Type::VARIABLE) {
+                auto [it, inserted] = symbols.emplace(node->symbol, static_cast<uint32_t>(symbols.size()));
+                if (inserted) {
+                    names += node->name();
+                    offsets.push_back(static_cast<uint32_t>(names.size()));
+                }
+                entry.left = it->second;
+            } else if (node->terms) {
+                entry.left = static_cast<Id>(operands.size());
+                entry.right = static_cast<Id>(node->terms->size());
+                for (const auto& term : *node->terms) {
+                    Id child = index.at(term.get());
+                    operands.push_back(child);
+                    ++parents[child];
+                }
+                if (operands.size() >= Image::none) throw runtime_error("Expression too large to serialize");
+            } else {
+                entry.left = index.at(node->left.get());
+                ++parents[entry.left];
+                if (node->right) {
+                    entry.right = index.at(node->right.get());
+                    ++parents[entry.right];
+                }
+            }
+            if (nodes.size() >= Image::none) throw runtime_error("Expression too large to serialize");
+            index.emplace(node, static_cast<Id>(nodes.size()));
+            nodes.push_back(entry);
+            parents.push_back(0);
+        }
+        Id root = index.at(expr.root.get());
+        ++parents[root];
+        roots.push_back(root);
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (parents[i] > 1) nodes[i].flags |= Image::SHARED;
+    }
+
+    typename Image::Header header{};
+    memcpy(header.magic, imageMagic, sizeof(imageMagic));
+    header.byteOrder = imageByteOrder;
+    header.version = Image::version;
+    header.scalar = scalarCode<T>();
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.constantCount = static_cast<uint32_t>(constants.size());
+    header.symbolCount = static_cast<uint32_t>(symbols.size());
+    header.rootCount = static_cast<uint32_t>(roots.size());
+    header.nameBytes = static_cast<uint32_t>(names.size());
+    header.operandCount = static_cast<uint32_t>(operands.size());
+    Layout layout = layoutOf<T>(header);
+    header.size = layout.size;
+
+    vector<unsigned char> out(layout.size);
+    auto put = [&](uint64_t offset, const void* source, size_t bytes) {
+        if (bytes) memcpy(out.data() + offset, source, bytes);
+    };
+    put(0, &header, sizeof(header));
+    put(layout.constants, constants.data(), constants.size() * sizeof(T));
+    put(layout.nodes, nodes.data(), nodes.size() * sizeof(typename Image::Node));
+    put(layout.operands, operands.data(), operands.size() * sizeof(Id));
+    put(layout.roots, roots.data(), roots.size() * sizeof(Id));
+    put(layout.offsets, offsets.data(), offsets.size() * sizeof(uint32_t));
+    put(layout.names, names.data(), names.size());
+    return out;
+}
+
+template <typename T>
+Expression<T> Expression<T>::deserialize(const void* data, size_t size) {
+    ExpressionImage<T> image(data, size);
+    if (image.size() == 0) throw runtime_error("Expression image is empty");
+    return image.expression(0);
+}
+
+// Открытие образа
+template <typename T>
+ExpressionImage<T>::ExpressionImage(const void* data, size_t size) {
+    attach(data, size);
+}
+
+template <typename T>
+ExpressionImage<T> ExpressionImage<T>::map(const string& path) {
+#ifdef EXPRESSION_IMAGE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("Cannot open expression image: " + path);
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        throw runtime_error("Cannot read expression image: " + path);
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* memory = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) throw runtime_error("Cannot map expression image: " + path);
+
+    ExpressionImage image;
+    image.mapping = memory;
+    image.mappingSize = size;
+    image.attach(memory, size);
+    return image;
+#else
+    (void)path;
+    throw runtime_error("Mapping expression images is not supported on this platform");
+#endif
+}
+
+template <typename T>
+ExpressionImage<T>::ExpressionImage(ExpressionImage&& other) noexcept {
+    *this = move(other);
+}
+
+template <typename T>
+ExpressionImage<T>& ExpressionImage<T>::operator=(ExpressionImage&& other) noexcept {
+    swap(data, other.data);
+    swap(mapping, other.mapping);
+    swap(mappingSize, other.mappingSize);
+    swap(header, other.header);
+    swap(constants, other.constants);
+    swap(nodes, other.nodes);
+    swap(operands, other.operands);
+    swap(roots, other.roots);
+    swap(offsets, other.offsets);
+    swap(names, other.names);
+    return *this;
+}
+
+template <typename T>
+ExpressionImage<T>::~ExpressionImage() {
+#ifdef EXPRESSION_IMAGE_MMAP
+    if (mapping) ::munmap(mapping, mappingSize);
+#endif
+}
+
+template <typename T>
+void ExpressionImage<T>::attach(const void* memory, size_t size) {
+    // Отображение уже принадлежит образу, поэтому при ошибке оно освободится в деструкторе
+    auto fail = [](const string& message) -> void {
+        throw runtime_error("Invalid expression image: " + message);
+    };
+    if (reinterpret_cast<uintptr_t>(memory) % alignof(T) != 0) fail("misaligned buffer");
+    if (size < sizeof(Header)) fail("truncated header");
+    data = static_cast<const unsigned char*>(memory);
+    header = reinterpret_cast<const Header*>(data);
+    if (memcmp(header->magic, imageMagic, sizeof(imageMagic)) != 0) fail("bad magic");
+    if (header->byteOrder != imageByteOrder) fail("foreign byte order");
+    if (header->version != version) fail("unsupported version " + to_string(header->version));
+    if (header->scalar != scalarCode<T>()) fail("scalar type mismatch");
+    Layout layout = layoutOf<T>(*header);
+    if (header->size != layout.size || size < layout.size) fail("truncated data");
+
+    constants = reinterpret_cast<const T*>(data + layout.constants);
+    nodes = reinterpret_cast<const Node*>(data + layout.nodes);
+    operands = reinterpret_cast<const Id*>(data + layout.operands);
+    roots = reinterpret_cast<const Id*>(data + layout.roots);
+    offsets = reinterpret_cast<const uint32_t*>(data + layout.offsets);
+    names = reinterpret_cast<const char*>(data + layout.names);
+
+    // Номера проверяются один раз, после этого обходы доверяют образу
+    for (Id i = 0; i < header->nodeCount; ++i) {
+        const Node& node = nodes[i];
+        if (node.type > lastType) fail("bad node type");
+        if (node.type == 0) {
+            if (node.left >= header->constantCount) fail("bad constant index");
+        } else if (node.type == 1) {
+            if (node.left >= header->symbolCount) fail("bad variable index");
+        } else if (node.type > lastUnary) {
+            if (node.right < 2 || uint64_t(node.left) + node.right > header->operandCount)
+                fail("bad operand list");
+            for (Id k = 0; k < node.right; ++k) {
+                if (operands[node.left + k] >= i) fail("bad operand index");
+            }
+        } else {
+            if (node.left >= i) fail("bad operand index");
+            bool binary = node.type <= lastBinary;
+            if (binary ? node.right >= i : node.right != none) fail("bad operand index");
+        }
+    }
+    for (uint32_t i = 0; i < header->rootCount; ++i) {
+        if (roots[i] >= header->nodeCount) fail("bad root index");
+    }
+    if (offsets[0] != 0 || offsets[header->symbolCount] != header->nameBytes) fail("bad name table");
+    for (uint32_t i = 0; i < header->symbolCount; ++i) {
+        if (offsets[i] > offsets[i + 1]) fail("bad name table");
+    }
+}
+
+template <typename T>
+string_view ExpressionImage<T>::variable(size_t index) const {
+    if (index >= header->symbolCount) throw out_of_range("Variable index out of range");
+    return string_view(names + offsets[index], offsets[index + 1] - offsets[index]);
+}
+
+template <typename T>
+typename ExpressionImage<T>::Id ExpressionImage<T>::root(size_t index) const {
+    if (index >= header->rootCount) throw out_of_range("Expression index out of range");
+    return roots[index];
+}
+
+// Вычисление прямо по образу
+template <typename T>
+template <typename Variable>
+T ExpressionImage<T>::run(Id root, Variable&& variable) const {
+    using Type = typename Expression<T>::Node::Type;
+    // Тот же обход, что у Node::fold: запоминаются только общие узлы
+    struct Frame {
+        Id node;
+        bool expanded;
+    };
+    unordered_map<Id, T> memo;
+    vector<T> values;
+    vector<Frame> stack{{root, false}};
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        const Node& node = nodes[frame.node];
+        bool shared = node.flags & SHARED;
+        Type type = static_cast<Type>(node.type);
+        bool nary = node.type > lastUnary;
+        if (frame.expanded) {
+            stack.pop_back();
+            size_t arity = nary ? node.right : node.right != none ? 2 : 1;
+            const T* items = &values[values.size() - arity];
+            bool constantExponent = type == Type::POWER &&
+                                    nodes[node.right].type == static_cast<uint8_t>(Type::CONSTANT);
+            T value = nary ? Expression<T>::Node::reduce(type, items, arity)
+                           : apply(type, items[0], arity == 2 ? items[1] : T(0), constantExponent);
+            values.resize(values.size() - arity);
+            if (shared) memo.emplace(frame.node, value);
+            values.push_back(value);
+            continue;
+        }
+        if (shared) {
+            auto it = memo.find(frame.node);
+            if (it != memo.end()) {
+                stack.pop_back();
+                values.push_back(it->second);
+                continue;
+            }
+        }
+        if (type == Type::CONSTANT || type == Type::VARIABLE) {
+            stack.pop_back();
+            T value = type == Type::CONSTANT ? constants[node.left] : variable(node.left);
+            if (shared) memo.emplace(frame.node, value);
+            values.push_back(value);
+            continue;
+        }
+        stack.back().expanded = true;
+        if (nary) {
+            for (Id k = node.right; k-- > 0;) stack.push_back({operands[node.left + k], false});
+            continue;
+        }
+        if (node.right != none) stack.push_back({node.right, false});
+        stack.push_back({node.left, false});
+    }
+    return values.back();
+}
+
+template <typename T>
+T ExpressionImage<T>::evaluate(size_t index, const T* values) const {
+    return run(root(index), [&](Id symbol) { return values[symbol]; });
+}
+
+template <typename T>
+T ExpressionImage<T>::evaluate(size_t index, const std::map<string, T>& variables) const {
+    Id node = root(index);
+    // Имена образа сопоставляются с variables один раз на вызов
+    vector<const T*> bound(header->symbolCount, nullptr);
+    for (uint32_t i = 0; i < header->symbolCount; ++i) {
+        auto it = variables.find(string(variable(i)));
+        if (it != variables.end()) bound[i] = &it->second;
+    }
+    return run(node, [&](Id symbol) {
+        if (!bound[symbol]) throw runtime_error("Undefined variable: " + string(variable(symbol)));
+        return *bound[symbol];
+    });
+}
+
+// Перенос в Expression
+template <typename T>
+Expression<T> ExpressionImage<T>::expression(size_t index) const {
+    using ExprNode = typename Expression<T>::Node;
+    using ExprType = typename ExprNode::Type;
+
+    Id top = root(index);
+    // Потомки раньше родителей: достижимые узлы отмечаются проходом сверху вниз
+    vector<bool> marks(top + 1, false);
+    marks[top] = true;
+    for (Id i = top + 1; i-- > 0;) {
+        if (!marks[i] || nodes[i].type <= 1) continue;
+        if (nodes[i].type > lastUnary) {
+            for (Id k = 0; k < nodes[i].right; ++k) marks[operands[nodes[i].left + k]] = true;
+            continue;
+        }
+        marks[nodes[i].left] = true;
+        if (nodes[i].right != none) marks[nodes[i].right] = true;
+    }
+
+    vector<SymbolTable::Symbol> symbols(header->symbolCount, SymbolTable::none);
+    vector<shared_ptr<ExprNode>> built(top + 1);
+    for (Id i = 0; i <= top; ++i) {
+        if (!marks[i]) continue;
+        const Node& n = nodes[i];
+        ExprType type = static_cast<ExprType>(n.type);
+        if (type == ExprType::CONSTANT) {
+            built[i] = ExprNode::make(type, constants[n.left]);
+        } else if (type == ExprType::VARIABLE) {
+            if (symbols[n.left] == SymbolTable::none)
+                symbols[n.left] = SymbolTable::intern(string(variable(n.left)));
+            built[i] = ExprNode::make(type, symbols[n.left]);
+        } else if (n.type > lastUnary) {
+            vector<shared_ptr<ExprNode>> terms(n.right);
+            for (Id k = 0; k < n.right; ++k) terms[k] = built[operands[n.left + k]];
+            built[i] = ExprNode::make(type, move(terms));
+        } else if (n.right != none) {
+            built[i] = ExprNode::make(type, built[n.left], built[n.right]);
+        } else {
+            built[i] = ExprNode::make(type, built[n.left]);
+        }
+    }
+    return Expression<T>(built[top]);
+}
+
+// Явное инстанцирование шаблонов
+template class ExpressionImage<double>;
+template class ExpressionImage<complex<double>>;
+template vector<unsigned char> Expression<double>::serialize() const;
+template vector<unsigned char> Expression<double>::serialize(const vector<Expression<double>>&);
+template Expression<double> Expression<double>::deserialize(const void*, size_t);
+template vector<unsigned char> Expression<complex<double>>::serialize() const;
+template vector<unsigned char>
+Expression<complex<double>>::serialize(const vector<Expression<complex<double>>>&);
+template Expression<complex<double>> Expression<complex<double>>::deserialize(const void*, size_t);
@@ -0,0 +1,270 @@
+#include "expression_incremental.hpp"
+#include "detail/node.hpp"
+#include "detail/power.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+// Построение плоского представления
+template <typename T>
+IncrementalEvaluator<T>::IncrementalEvaluator(const Expression<T>& expr) {
+    using Node = typename Expression<T>::Node;
+
+    // Постфиксный обход без рекурсии: потомок получает номер раньше родителя
+    unordered_map<const Node*, Id> index;
+    vector<const Node*> order;
+    vector<pair<const Node*, bool>> stack{{expr.root.get(), false}};
+    while (!stack.empty()) {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+        if (index.count(node)) continue;
+        if (expanded) {
+            index.emplace(node, static_cast<Id>(order.size()));
+            order.push_back(node);
+            continue;
+        }
+        stack.emplace_back(node, true);
+        for (size_t k = node->arity(); k-- > 0;) stack.emplace_back(node->child(k).get(), false);
+    }
+
+    size_t count = order.size();
+    steps.resize(count);
+    values.resize(count);
+    vector<Id> parentCount(count + 1, 0);
+    // Потомок, встречающийся у родителя несколько раз, учитывается один раз
+    vector<Id> lastParent(count, Id(count));
+    auto link = [&](Id child, size_t parent) {
+        if (lastParent[child] == parent) return false;
+        lastParent[child] = static_cast<Id>(parent);
+        return true;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        const Node* node = order[i];
+        Step& step = steps[i];
+        step.type = static_cast<uint8_t>(node->type);
+        step.lhs = step.rhs = 0;
+        if (node->type == Node::Type::CONSTANT) {
+            values[i] = node->value;
+        } else if (node->type == Node::Type::VARIABLE) {
+            step.lhs = static_cast<Id>(slots.size());
+            slots.push_back(node->name());
+            slotNodes.push_back(static_cast<Id>(i));
+        } else if (node->terms) {
+            // У n-арного узла lhs - начало номеров потомков в operands, rhs - их число
+            step.lhs = static_cast<Id>(operands.size());
+            step.rhs = static_cast<Id>(node->terms->size());
+            for (const auto& term : *node->terms) {
+                Id child = index[term.get()];
+                operands.push_back(child);
+                if (link(child, i)) ++parentCount[child];
+            }
+        } else {
+            step.lhs = index[node->left.get()];
+            if (link(step.lhs, i)) ++parentCount[step.lhs];
+            if (node->right) {
+                step.rhs = index[node->right.get()];
+                if (link(step.rhs, i)) ++parentCount[step.rhs];
+            }
+        }
+    }
+
+    // Родители каждого узла подряд: parents[parentFirst[i]..parentFirst[i + 1])
+    vector<Id> parentFirst(count + 1, 0);
+    for (size_t i = 0; i < count; ++i) parentFirst[i + 1] = parentFirst[i] + parentCount[i];
+    vector<Id> parents(parentFirst[count]);
+    vector<Id> fill(parentFirst.begin(), parentFirst.end() - 1);
+    lastParent.assign(count, Id(count));
+    for (size_t i = 0; i < count; ++i) {
+        const Node* node = order[i];
+        auto add = [&](Id child) {
+            if (link(child, i)) parents[fill[child]++] = static_cast<Id>(i);
+        };
+        if (node->terms) {
+            for (Id k = 0; k < steps[i].rhs; ++k) add(operands[steps[i].lhs + k]);
+        } else if (node->left) {
+            add(steps[i].lhs);
+            if (node->right) add(steps[i].rhs);
+        }
+    }
+
+    // Зависимые узлы каждой переменной: подъём по родителям от её узла
+    vector<bool> mark(count, false);
+    first.push_back(0);
+    for (Id start : slotNodes) {
+        size_t begin = dependents.size();
+        dependents.push_back(start);
+        mark[start] = true;
+        for (size_t k = begin; k < dependents.size(); ++k) {
+            Id node = dependents[k];
+            for (Id p = parentFirst[node]; p < parentFirst[node + 1]; ++p) {
+                Id parent = parents[p];
+                if (mark[parent]) continue;
+                mark[parent] = true;
+                dependents.push_back(parent);
+            }
+        }
+        for (size_t k = begin; k < dependents.size(); ++k) mark[dependents[k]] = false;
+        sort(dependents.begin() + static_cast<ptrdiff_t>(begin), dependents.end());
+        first.push_back(static_cast<Id>(dependents.size()));
+    }
+
+    assigned.assign(slots.size(), false);
+    dirty.assign(slots.size(), false);
+    changed.assign(count, false);
+}
+
+template <typename T>
+IncrementalEvaluator<T>::IncrementalEvaluator(const Expression<T>& expr,
+                                              const map<string, T>& values)
+    : IncrementalEvaluator(expr) {
+    for (const auto& [name, value] : values) set(name, value);
+}
+
+template <typename T>
+size_t IncrementalEvaluator<T>::slot(const string& variable) const {
+    auto it = find(slots.begin(), slots.end(), variable);
+    if (it == slots.end()) throw runtime_error("Undefined variable: " + variable);
+    return static_cast<size_t>(it - slots.begin());
+}
+
+template <typename T>
+bool IncrementalEvaluator<T>::nary(const Step& step) {
+    using Type = typename Expression<T>::Node::Type;
+    Type type = static_cast<Type>(step.type);
+    return type == Type::SUM || type == Type::COMPENSATED_SUM || type == Type::PRODUCT;
+}
+
+// Изменение переменных
+template <typename T>
+void IncrementalEvaluator<T>::set(const string& variable, T value) {
+    auto it = find(slots.begin(), slots.end(), variable);
+    if (it != slots.end()) set(static_cast<size_t>(it - slots.begin()), value);
+}
+
+template <typename T>
+void IncrementalEvaluator<T>::set(size_t slot, T value) {
+    if (slot >= slots.size()) throw out_of_range("Variable slot out of range");
+    T& current = values[slotNodes[slot]];
+    // Значения сравниваются побитово, чтобы NaN не считался изменением каждый раз
+    if (assigned[slot] && memcmp(&current, &value, sizeof(T)) == 0) return;
+    current = value;
+    assigned[slot] = true;
+    if (!dirty[slot]) {
+        dirty[slot] = true;
+        dirtySlots.push_back(static_cast<Id>(slot));
+    }
+}
+
+// Пересчёт
+template <typename T>
+T IncrementalEvaluator<T>::compute(const Step& step) {
+    using Node = typename Expression<T>::Node;
+    using Type = typename Node::Type;
+    if (nary(step)) {
+        scratch.resize(step.rhs);
+        for (Id k = 0; k < step.rhs; ++k) scratch[k] = values[operands[step.lhs + k]];
+        return Node::reduce(static_cast<Type>(step.type), scratch.data(), step.rhs);
+    }
+    const T& a = values[step.lhs];
+    const T& b = values[step.rhs];
+    switch (static_cast<Type>(step.type)) {
+        case Type::ADD: return a + b;
+        case Type::SUBTRACT: return a - b;
+        case Type::MULTIPLY: return a * b;
+        case Type::DIVIDE: return a / b;
+        case Type::POWER:
+            if (steps[step.rhs].type == static_cast<uint8_t>(Type::CONSTANT))
+                return power::constant(a, b);
+            return std::pow(a, b);
+        case Type::SIN: return std::sin(a);
+        case Type::COS: return std::cos(a);
+        case Type::EXP: return std::exp(a);
+        case Type::LOG: return std::log(a);
+        case Type::NEGATE: return -a;
+        case Type::SUM:
+        case Type::COMPENSATED_SUM:
+        case Type::PRODUCT:
+        case Type::CONSTANT:
+        case Type::VARIABLE:
+            break;
+    }
+    return T(0);
+}
+
+template <typename T>
+T IncrementalEvaluator<T>::result() {
+    using Type = typename Expression<T>::Node::Type;
+
+    if (!computed) {
+        for (size_t s = 0; s < slots.size(); ++s) {
+            if (!assigned[s]) throw runtime_error("Undefined variable: " + slots[s]);
+        }
+        for (const Step& step : steps) {
+            if (step.type == static_cast<uint8_t>(Type::CONSTANT) ||
+                step.type == static_cast<uint8_t>(Type::VARIABLE))
+                continue;
+            values[&step - steps.data()] = compute(step);
+        }
+        for (Id s : dirtySlots) dirty[s] = false;
+        dirtySlots.clear();
+        computed = true;
+        lastRecomputed = steps.size();
+        return values.back();
+    }
+
+    // Зависимые узлы изменённых переменных в порядке возрастания номеров
+    const Id* begin = nullptr;
+    const Id* end = nullptr;
+    if (dirtySlots.size() == 1) {
+        begin = dependents.data() + first[dirtySlots[0]];
+        end = dependents.data() + first[dirtySlots[0] + 1];
+    } else if (!dirtySlots.empty()) {
+        merged.clear();
+        for (Id s : dirtySlots) {
+            mergeBuffer.clear();
+            std::merge(merged.begin(), merged.end(), dependents.begin() + first[s],
+                       dependents.begin() + first[s + 1], back_inserter(mergeBuffer));
+            merged.swap(mergeBuffer);
+        }
+        merged.erase(unique(merged.begin(), merged.end()), merged.end());
+        begin = merged.data();
+        end = merged.data() + merged.size();
+    }
+    for (Id s : dirtySlots) {
+        dirty[s] = false;
+        changed[slotNodes[s]] = true;
+    }
+    dirtySlots.clear();
+
+    // Узел пересчитывается, только если изменился хотя бы один его операнд
+    size_t count = 0;
+    for (const Id* it = begin; it != end; ++it) {
+        Id i = *it;
+        const Step& step = steps[i];
+        if (step.type == static_cast<uint8_t>(Type::VARIABLE)) continue;
+        if (nary(step)) {
+            const Id* children = operands.data() + step.lhs;
+            if (none_of(children, children + step.rhs, [&](Id k) { return bool(changed[k]); })) continue;
+        } else {
+            bool binary = step.type <= static_cast<uint8_t>(Type::POWER);
+            if (!changed[step.lhs] && !(binary && changed[step.rhs])) continue;
+        }
+        T value = compute(step);
+        ++count;
+        if (memcmp(&value, &values[i], sizeof(T)) != 0) {
+            values[i] = value;
+            changed[i] = true;
+        }
+    }
+    for (const Id* it = begin; it != end; ++it) changed[*it] = false;
+    lastRecomputed = count;
+    return values.back();
+}
+
+// Явное инстанцирование шаблонов
+template class IncrementalEvaluator<double>;
+template class IncrementalEvaluator<complex<double>>;
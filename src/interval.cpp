@@ -0,0 +1,228 @@
+#include "expression_interval.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+constexpr double infinity = numeric_limits<double>::infinity();
+constexpr double pi = 3.141592653589793;
+constexpr double twoPi = 2 * pi;
+
+// Наружное округление: результат округления к ближайшему отстоит от
+// точного значения не больше чем на ulp
+double down(double x) { return nextafter(x, -infinity); }
+double up(double x) { return nextafter(x, infinity); }
+
+// Функции libm: до двух ulp
+double down2(double x) { return down(down(x)); }
+double up2(double x) { return up(up(x)); }
+
+bool undefined(const Interval& a) { return a.lo != a.lo || a.hi != a.hi; }
+
+Interval nothing() {
+    double nan = numeric_limits<double>::quiet_NaN();
+    return {nan, nan};
+}
+
+Interval everything() { return {-infinity, infinity}; }
+
+// Произведение концов, в котором 0 * inf = 0: бесконечный конец - предел
+double times(double a, double b) { return a == 0 || b == 0 ? 0.0 : a * b; }
+
+// NaN в конце суммы - это inf - inf у бесконечных отрезков
+Interval bounded(const Interval& r) { return undefined(r) ? everything() : r; }
+
+Interval add(const Interval& a, const Interval& b) {
+    return bounded({down(a.lo + b.lo), up(a.hi + b.hi)});
+}
+
+Interval subtract(const Interval& a, const Interval& b) {
+    return bounded({down(a.lo - b.hi), up(a.hi - b.lo)});
+}
+
+Interval multiply(const Interval& a, const Interval& b) {
+    double p[4] = {times(a.lo, b.lo), times(a.lo, b.hi), times(a.hi, b.lo), times(a.hi, b.hi)};
+    return {down(*min_element(p, p + 4)), up(*max_element(p, p + 4))};
+}
+
+Interval divide(const Interval& a, const Interval& b) {
+    if (b.lo <= 0 && b.hi >= 0) return everything();
+    double q[4] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+    // inf / inf
+    for (double v : q) {
+        if (v != v) return everything();
+    }
+    return {down(*min_element(q, q + 4)), up(*max_element(q, q + 4))};
+}
+
+// x^k для x >= 0 с округлением каждого умножения в одну сторону
+double powerBound(double x, unsigned k, bool upper) {
+    double result = 1;
+    double base = x;
+    while (k) {
+        if (k & 1) result = upper ? up(result * base) : down(result * base);
+        k >>= 1;
+        if (k) base = upper ? up(base * base) : down(base * base);
+    }
+    return result;
+}
+
+Interval integerPower(const Interval& a, long long n) {
+    if (n == 0) return {1, 1};
+    unsigned k = static_cast<unsigned>(n < 0 ? -n : n);
+    Interval p;
+    if (k % 2) {
+        // Нечётная степень монотонна
+        p.lo = a.lo >= 0 ? powerBound(a.lo, k, false) : -powerBound(-a.lo, k, true);
+        p.hi = a.hi >= 0 ? powerBound(a.hi, k, true) : -powerBound(-a.hi, k, false);
+    } else {
+        double smallest = a.lo <= 0 && a.hi >= 0 ? 0.0 : min(fabs(a.lo), fabs(a.hi));
+        double largest = max(fabs(a.lo), fabs(a.hi));
+        p = {powerBound(smallest, k, false), powerBound(largest, k, true)};
+    }
+    if (n > 0) return p;
+    // Чётная отрицательная степень отрезка с нулём: 1/x^k >= 1/max^k
+    if (k % 2 == 0 && p.lo <= 0) return {max(down(1 / p.hi), 0.0), infinity};
+    return divide({1, 1}, p);
+}
+
+Interval power(const Interval& a, const Interval& b) {
+    if (b.lo == b.hi && b.lo == trunc(b.lo) && fabs(b.lo) <= 1 << 30)
+        return integerPower(a, static_cast<long long>(b.lo));
+    if (a.lo < 0) {
+        // У отрицательного основания степень определена лишь в целых точках
+        if (floor(b.hi) >= b.lo) return everything();
+        if (a.hi < 0) return nothing();
+    }
+    // x^y = exp(y log x) монотонна по каждому аргументу, поэтому крайние
+    // значения - в углах бокса
+    double x[2] = {max(a.lo, 0.0), a.hi};
+    double lo = infinity, hi = -infinity;
+    for (double base : x) {
+        for (double exponent : {b.lo, b.hi}) {
+            double v = std::pow(base, exponent);
+            lo = min(lo, v);
+            hi = max(hi, v);
+        }
+    }
+    return {max(down2(lo), 0.0), up2(hi)};
+}
+
+// Есть ли в [lo, hi] точка phase + 2 pi k; при сомнении - есть
+bool reaches(double lo, double hi, double phase) {
+    double slack = 1e-9 * (1 + fabs(lo) + fabs(hi));
+    double k = floor((lo - slack - phase) / twoPi);
+    for (int i = 0; i < 3; ++i, ++k) {
+        double point = phase + twoPi * k;
+        if (point >= lo - slack && point <= hi + slack) return true;
+    }
+    return false;
+}
+
+// Между экстремумами sin и cos монотонны: границы - значения на концах,
+// если внутрь не попал максимум или минимум
+Interval wave(const Interval& a, bool cosine) {
+    // Далеко от нуля редукция аргумента по 2 pi теряет точность
+    if (!(a.hi - a.lo < twoPi) || fabs(a.lo) > 1e9 || fabs(a.hi) > 1e9) return {-1, 1};
+    double first = cosine ? std::cos(a.lo) : std::sin(a.lo);
+    double last = cosine ? std::cos(a.hi) : std::sin(a.hi);
+    Interval r{max(down2(min(first, last)), -1.0), min(up2(max(first, last)), 1.0)};
+    if (reaches(a.lo, a.hi, cosine ? 0 : pi / 2)) r.hi = 1;
+    if (reaches(a.lo, a.hi, cosine ? pi : -pi / 2)) r.lo = -1;
+    return r;
+}
+
+Interval exp(const Interval& a) { return {max(down2(std::exp(a.lo)), 0.0), up2(std::exp(a.hi))}; }
+
+Interval log(const Interval& a) {
+    if (a.hi < 0) return nothing();
+    return {a.lo <= 0 ? -infinity : down2(std::log(a.lo)), up2(std::log(a.hi))};
+}
+
+Interval sqrt(const Interval& a) {
+    if (a.hi < 0) return nothing();
+    return {a.lo <= 0 ? 0.0 : max(down(std::sqrt(a.lo)), 0.0), up(std::sqrt(a.hi))};
+}
+
+} // namespace
+
+IntervalExpression::IntervalExpression(const Expression<double>& expr)
+    : IntervalExpression(expr.compile()) {}
+
+IntervalExpression::IntervalExpression(const CompiledExpression<double>& compiled)
+    : compiled(compiled) {}
+
+Interval IntervalExpression::evaluate(const map<string, Interval>& variables) const {
+    vector<Interval> values;
+    values.reserve(compiled.slots.size());
+    for (const string& name : compiled.slots) {
+        auto it = variables.find(name);
+        if (it == variables.end()) throw runtime_error("Undefined variable: " + name);
+        values.push_back(it->second);
+    }
+    return evaluate(values.data());
+}
+
+Interval IntervalExpression::evaluate(const Interval* values) const {
+    if (compiled.registers <= CompiledExpression<double>::inlineRegisters) {
+        Interval buffer[CompiledExpression<double>::inlineRegisters];
+        return evaluate(values, buffer);
+    }
+    vector<Interval> buffer(compiled.registers);
+    return evaluate(values, buffer.data());
+}
+
+Interval IntervalExpression::evaluate(const Interval* values, Interval* r) const {
+    using OpCode = CompiledExpression<double>::OpCode;
+    const double* c = compiled.constants.data();
+    for (const auto& in : compiled.program) {
+        // NaN-концы означают, что операнд нигде не определён; x^0 = 1 и
+        // для NaN, как у std::pow
+        bool binary = in.op >= OpCode::ADD && in.op <= OpCode::POWER;
+        // Поправка суммы от NaN - ноль
+        bool one = (in.op == OpCode::POWI && in.rhs == 0) || in.op == OpCode::COMPENSATION;
+        if (in.op != OpCode::CONSTANT && in.op != OpCode::VARIABLE && !one &&
+            (undefined(r[in.lhs]) || (binary && undefined(r[in.rhs])))) {
+            r[in.dst] = nothing();
+            if (in.op == OpCode::SINCOS) r[in.rhs] = nothing();
+            continue;
+        }
+        switch (in.op) {
+            case OpCode::CONSTANT: r[in.dst] = {c[in.lhs], c[in.lhs]}; break;
+            case OpCode::VARIABLE: r[in.dst] = values[in.lhs]; break;
+            case OpCode::ADD: r[in.dst] = add(r[in.lhs], r[in.rhs]); break;
+            case OpCode::SUBTRACT: r[in.dst] = subtract(r[in.lhs], r[in.rhs]); break;
+            case OpCode::MULTIPLY: r[in.dst] = multiply(r[in.lhs], r[in.rhs]); break;
+            case OpCode::DIVIDE: r[in.dst] = divide(r[in.lhs], r[in.rhs]); break;
+            case OpCode::POWER: r[in.dst] = power(r[in.lhs], r[in.rhs]); break;
+            case OpCode::SIN: r[in.dst] = wave(r[in.lhs], false); break;
+            case OpCode::COS: r[in.dst] = wave(r[in.lhs], true); break;
+            case OpCode::EXP: r[in.dst] = exp(r[in.lhs]); break;
+            case OpCode::LOG: r[in.dst] = log(r[in.lhs]); break;
+            case OpCode::NEGATE: r[in.dst] = {-r[in.lhs].hi, -r[in.lhs].lo}; break;
+            case OpCode::SQUARE: r[in.dst] = integerPower(r[in.lhs], 2); break;
+            case OpCode::RECIPROCAL: r[in.dst] = divide({1, 1}, r[in.lhs]); break;
+            case OpCode::SQRT: r[in.dst] = sqrt(r[in.lhs]); break;
+            case OpCode::POWI:
+                r[in.dst] = integerPower(r[in.lhs], static_cast<int32_t>(in.rhs));
+                break;
+            case OpCode::SINCOS: {
+                Interval a = r[in.lhs];
+                r[in.dst] = wave(a, false);
+                r[in.rhs] = wave(a, true);
+                break;
+            }
+            case OpCode::COMPENSATION: {
+                // Бесконечные концы заменяются нулём, конечные значения внутри остаются
+                Interval a = r[in.lhs];
+                if (undefined(a)) r[in.dst] = {0, 0};
+                else if (isfinite(a.lo) && isfinite(a.hi)) r[in.dst] = a;
+                else r[in.dst] = {min(a.lo, 0.0), max(a.hi, 0.0)};
+                break;
+            }
+        }
+    }
+    return r[compiled.result];
+}
@@ -0,0 +1,432 @@
+#include "expression_jit.hpp"
+#include "detail/power.hpp"
+#include "detail/trig.hpp"
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define EXPRESSION_JIT_X86_64 1
+#endif
+
+using namespace std;
+
+namespace {
+
+#ifdef EXPRESSION_JIT_X86_64
+
+// Функции, которые генерируемый код вызывает по указателю:
+// out, a и b - адреса ячеек в кадре стека
+template <typename T> void callPow(T* out, const T* a, const T* b) { *out = std::pow(*a, *b); }
+template <typename T> void callSin(T* out, const T* a, const T*) { *out = std::sin(*a); }
+template <typename T> void callCos(T* out, const T* a, const T*) { *out = std::cos(*a); }
+template <typename T> void callExp(T* out, const T* a, const T*) { *out = std::exp(*a); }
+template <typename T> void callLog(T* out, const T* a, const T*) { *out = std::log(*a); }
+template <typename T> void callMultiply(T* out, const T* a, const T* b) { *out = *a * *b; }
+template <typename T> void callDivide(T* out, const T* a, const T* b) { *out = *a / *b; }
+template <typename T> void callSquare(T* out, const T* a, const T*) { *out = power::square(*a); }
+template <typename T> void callReciprocal(T* out, const T* a, const T*) { *out = T(1) / *a; }
+template <typename T> void callSqrt(T* out, const T* a, const T*) { *out = std::sqrt(*a); }
+// Третий аргумент - показатель, а не адрес
+template <typename T> void callPowi(T* out, const T* a, int64_t n) {
+    *out = power::integer(*a, static_cast<int>(n));
+}
+// Третий аргумент - ячейка регистра косинуса; она может совпадать с a
+template <typename T> void callSinCos(T* out, const T* a, T* c) { trig::sincos(*a, *out, *c); }
+template <typename T> void callCompensation(T* out, const T* a, const T*) {
+    *out = scalar::compensation(*a);
+}
+
+// Регистры общего назначения
+enum : int { RAX = 0, RDX = 2, RSP = 4, RBX = 3, RSI = 6, RDI = 7, R12 = 12 };
+
+// Операнд SSE-инструкции: регистр xmm или память [base + disp]
+struct Operand {
+    bool memory;
+    int reg;
+    int base;
+    int32_t disp;
+
+    static Operand xmm(int r) { return {false, r, 0, 0}; }
+    static Operand at(int base, int32_t disp) { return {true, 0, base, disp}; }
+};
+
+class Emitter {
+public:
+    vector<uint8_t> code;
+
+    void bytes(initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) code.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; ++i) code.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    // [prefix] [REX] 0F op ModRM: reg - регистр xmm, rm - регистр или память
+    void sse(uint8_t prefix, uint8_t op, int reg, const Operand& rm) {
+        if (prefix) code.push_back(prefix);
+        int b = rm.memory ? rm.base : rm.reg;
+        uint8_t rex = static_cast<uint8_t>(0x40 | ((reg >> 3) << 2) | (b >> 3));
+        if (rex != 0x40) code.push_back(rex);
+        code.push_back(0x0F);
+        code.push_back(op);
+        modrm(reg, rm);
+    }
+
+    // lea r64, [base + disp]
+    void lea(int dst, int base, int32_t disp) {
+        code.push_back(static_cast<uint8_t>(0x48 | ((dst >> 3) << 2) | (base >> 3)));
+        code.push_back(0x8D);
+        modrm(dst, Operand::at(base, disp));
+    }
+
+    // mov r64, imm64; возвращает смещение непосредственного значения
+    size_t movImmediate(int dst, uint64_t value) {
+        code.push_back(static_cast<uint8_t>(0x48 | (dst >> 3)));
+        code.push_back(static_cast<uint8_t>(0xB8 | (dst & 7)));
+        size_t offset = code.size();
+        u64(value);
+        return offset;
+    }
+
+private:
+    void modrm(int reg, const Operand& rm) {
+        if (!rm.memory) {
+            code.push_back(static_cast<uint8_t>(0xC0 | ((reg & 7) << 3) | (rm.reg & 7)));
+            return;
+        }
+        // mod = 10: всегда 32-битное смещение; rsp и r12 требуют байт SIB
+        code.push_back(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | (rm.base & 7)));
+        if ((rm.base & 7) == RSP) code.push_back(0x24);
+        u32(static_cast<uint32_t>(rm.disp));
+    }
+};
+
+// Различия между double (скалярные sd) и complex<double> (пара re, im в одном xmm)
+template <typename T>
+struct Traits;
+
+template <>
+struct Traits<double> {
+    static constexpr uint8_t prefix = 0xF2;        // movsd, addsd, ...
+    static constexpr bool inlineMultiply = true;   // mulsd и divsd
+};
+
+template <>
+struct Traits<complex<double>> {
+    static constexpr uint8_t prefix = 0x66;        // movupd, addpd, ...
+    static constexpr bool inlineMultiply = false;  // умножение и деление - вызовом
+};
+
+constexpr uint8_t LOAD = 0x10, STORE = 0x11, ADD = 0x58, MUL = 0x59, SUB = 0x5C, DIV = 0x5E;
+constexpr uint8_t SQRT = 0x51;
+constexpr uint8_t MOVAPD = 0x28, XORPD = 0x57, ANDPD = 0x54, CMP = 0xC2;
+
+// Физические регистры xmm0-xmm13 для значений, xmm15 - рабочий
+constexpr uint32_t physical = 14;
+constexpr int scratch = 15;
+// Каждая ячейка кадра - 16 байт, чтобы операнды в памяти были выровнены для *pd
+constexpr int32_t cell = 16;
+
+template <typename T>
+class Generator {
+public:
+    using OpCode = typename CompiledExpression<T>::OpCode;
+    using Instruction = typename CompiledExpression<T>::Instruction;
+
+    Generator(const vector<Instruction>& program, uint32_t registers, uint32_t result)
+        : program(program), registers(registers), result(result) {}
+
+    // Возвращает смещение в коде адреса данных (маска знака и константы)
+    size_t emit() {
+        // Кадр: ячейка 16*r - дом виртуального регистра r (для r < 14 - место
+        // сохранения xmm r при вызовах), за ними ячейка результата вызова.
+        // После push rbx, push r12 и sub rsp кадр выровнен на 16.
+        uint32_t cells = max(registers, physical) + 1;
+        out = static_cast<int32_t>(cell * (cells - 1));
+        int32_t frame = cell * static_cast<int32_t>(cells) + 8;
+
+        e.bytes({0x53, 0x41, 0x54});                 // push rbx; push r12
+        e.bytes({0x48, 0x89, 0xFB});                 // mov rbx, rdi
+        size_t data = e.movImmediate(R12, 0);        // mov r12, данные
+        e.bytes({0x48, 0x81, 0xEC});                 // sub rsp, frame
+        e.u32(static_cast<uint32_t>(frame));
+
+        computeLiveness();
+        for (size_t i = 0; i < program.size(); ++i) instruction(i);
+
+        move(0, location(result));
+        if constexpr (!is_same_v<T, double>) {
+            e.bytes({0x0F, 0x12, 0xC8});             // movhlps xmm1, xmm0: мнимая часть
+        }
+        e.bytes({0x48, 0x81, 0xC4});                 // add rsp, frame
+        e.u32(static_cast<uint32_t>(frame));
+        e.bytes({0x41, 0x5C, 0x5B, 0xC3});           // pop r12; pop rbx; ret
+        return data;
+    }
+
+    vector<uint8_t>& code() { return e.code; }
+
+private:
+    const vector<Instruction>& program;
+    uint32_t registers;
+    uint32_t result;
+    int32_t out = 0;
+    Emitter e;
+    // Живые физические регистры до и после каждой инструкции (битовые маски)
+    vector<uint16_t> liveBefore, liveAfter;
+
+    static constexpr uint8_t p = Traits<T>::prefix;
+
+    static bool isLeaf(OpCode op) { return op == OpCode::CONSTANT || op == OpCode::VARIABLE; }
+
+    static bool isBinary(OpCode op) {
+        return op == OpCode::ADD || op == OpCode::SUBTRACT || op == OpCode::MULTIPLY ||
+               op == OpCode::DIVIDE || op == OpCode::POWER;
+    }
+
+    static uint16_t bit(uint32_t r) { return r < physical ? static_cast<uint16_t>(1u << r) : 0; }
+
+    static Operand home(uint32_t r) { return Operand::at(RSP, cell * static_cast<int32_t>(r)); }
+
+    static Operand location(uint32_t r) { return r < physical ? Operand::xmm(r) : home(r); }
+
+    void computeLiveness() {
+        liveBefore.resize(program.size());
+        liveAfter.resize(program.size());
+        uint16_t live = bit(result);
+        for (size_t i = program.size(); i-- > 0;) {
+            const Instruction& in = program[i];
+            liveAfter[i] = live;
+            live &= static_cast<uint16_t>(~bit(in.dst));
+            if (in.op == OpCode::SINCOS) live &= static_cast<uint16_t>(~bit(in.rhs));
+            if (!isLeaf(in.op)) live |= bit(in.lhs);
+            if (isBinary(in.op)) live |= bit(in.rhs);
+            liveBefore[i] = live;
+        }
+    }
+
+    // xmm dst <- src (регистр или память)
+    void move(int dst, const Operand& src) {
+        if (!src.memory) {
+            if (src.reg != dst) e.sse(0x66, MOVAPD, dst, src);
+            return;
+        }
+        e.sse(p, LOAD, dst, src);
+    }
+
+    // Запись значения из xmm src в расположение регистра dst
+    void assign(uint32_t dst, int src) {
+        if (dst < physical) {
+            if (static_cast<int>(dst) != src) e.sse(0x66, MOVAPD, dst, Operand::xmm(src));
+        } else {
+            e.sse(p, STORE, src, home(dst));
+        }
+    }
+
+    void load(uint32_t dst, const Operand& src) {
+        if (dst < physical) {
+            e.sse(p, LOAD, dst, src);
+        } else {
+            e.sse(p, LOAD, scratch, src);
+            e.sse(p, STORE, scratch, home(dst));
+        }
+    }
+
+    void binary(uint8_t op, const Instruction& in) {
+        if (in.dst < physical && in.dst == in.lhs) {
+            e.sse(p, op, in.dst, location(in.rhs));
+        } else if (in.dst < physical && in.dst != in.rhs) {
+            move(in.dst, location(in.lhs));
+            e.sse(p, op, in.dst, location(in.rhs));
+        } else {
+            move(scratch, location(in.lhs));
+            e.sse(p, op, scratch, location(in.rhs));
+            assign(in.dst, scratch);
+        }
+    }
+
+    template <typename Third>
+    void call(void (*function)(T*, const T*, Third), size_t i) {
+        const Instruction& in = program[i];
+        // Все xmm сохраняются вызывающей стороной: живые значения уходят в
+        // свои ячейки, операнды передаются адресами этих ячеек. Косинус SINCOS
+        // функция пишет прямо в ячейку rhs, откуда он читается как живой
+        // после вызова регистр
+        for (uint32_t r = 0; r < physical; ++r) {
+            if (liveBefore[i] & bit(r)) e.sse(p, STORE, r, home(r));
+        }
+        e.lea(RDI, RSP, out);
+        e.lea(RSI, RSP, home(in.lhs).disp);
+        if (isBinary(in.op) || in.op == OpCode::SINCOS) e.lea(RDX, RSP, home(in.rhs).disp);
+        if (in.op == OpCode::POWI)
+            e.movImmediate(RDX, static_cast<uint64_t>(int64_t(static_cast<int32_t>(in.rhs))));
+        e.movImmediate(RAX, reinterpret_cast<uint64_t>(function));
+        e.bytes({0xFF, 0xD0});                       // call rax
+        for (uint32_t r = 0; r < physical; ++r) {
+            if ((liveAfter[i] & bit(r)) && r != in.dst) e.sse(p, LOAD, r, home(r));
+        }
+        load(in.dst, Operand::at(RSP, out));
+    }
+
+    void instruction(size_t i) {
+        const Instruction& in = program[i];
+        switch (in.op) {
+            case OpCode::CONSTANT:
+                load(in.dst, Operand::at(R12, cell + static_cast<int32_t>(sizeof(T) * in.lhs)));
+                break;
+            case OpCode::VARIABLE:
+                load(in.dst, Operand::at(RBX, static_cast<int32_t>(sizeof(T) * in.lhs)));
+                break;
+            case OpCode::ADD: binary(ADD, in); break;
+            case OpCode::SUBTRACT: binary(SUB, in); break;
+            case OpCode::MULTIPLY:
+                if (Traits<T>::inlineMultiply) binary(MUL, in);
+                else call(callMultiply<T>, i);
+                break;
+            case OpCode::DIVIDE:
+                if (Traits<T>::inlineMultiply) binary(DIV, in);
+                else call(callDivide<T>, i);
+                break;
+            case OpCode::POWER: call(callPow<T>, i); break;
+            case OpCode::SIN: call(callSin<T>, i); break;
+            case OpCode::COS: call(callCos<T>, i); break;
+            case OpCode::EXP: call(callExp<T>, i); break;
+            case OpCode::LOG: call(callLog<T>, i); break;
+            case OpCode::NEGATE:
+                // Смена знака - xorpd с маской знаковых битов в начале данных
+                move(scratch, location(in.lhs));
+                e.sse(0x66, XORPD, scratch, Operand::at(R12, 0));
+                assign(in.dst, scratch);
+                break;
+            case OpCode::SQUARE:
+                if (Traits<T>::inlineMultiply) binary(MUL, {in.op, in.dst, in.lhs, in.lhs});
+                else call(callSquare<T>, i);
+                break;
+            case OpCode::SQRT:
+                // sqrtsd совпадает с std::sqrt; у sqrtpd другой смысл, поэтому complex - вызовом
+                if constexpr (is_same_v<T, double>) {
+                    e.sse(p, SQRT, scratch, location(in.lhs));
+                    assign(in.dst, scratch);
+                } else {
+                    call(callSqrt<T>, i);
+                }
+                break;
+            case OpCode::RECIPROCAL: call(callReciprocal<T>, i); break;
+            case OpCode::POWI: call(callPowi<T>, i); break;
+            case OpCode::SINCOS: call(callSinCos<T>, i); break;
+            case OpCode::COMPENSATION:
+                // x - x равно 0 для конечного x и NaN иначе; cmpeqsd даёт из
+                // этого маску, andpd оставляет x или ноль
+                if constexpr (is_same_v<T, double>) {
+                    move(scratch, location(in.lhs));
+                    e.sse(p, SUB, scratch, location(in.lhs));
+                    e.sse(p, CMP, scratch, Operand::xmm(scratch));
+                    e.bytes({0x00});                 // предикат EQ
+                    e.sse(0x66, ANDPD, scratch, location(in.lhs));
+                    assign(in.dst, scratch);
+                } else {
+                    call(callCompensation<T>, i);
+                }
+                break;
+        }
+    }
+};
+
+#endif // EXPRESSION_JIT_X86_64
+
+} // namespace
+
+// Генерация машинного кода
+template <typename T>
+JitExpression<T>::JitExpression(const Expression<T>& expr) : JitExpression(expr.compile()) {}
+
+template <typename T>
+JitExpression<T>::JitExpression(const CompiledExpression<T>& compiled) : slots(compiled.slots) {
+#ifdef EXPRESSION_JIT_X86_64
+    if (compiled.registers > (1u << 26) || compiled.constants.size() > (1u << 26) ||
+        compiled.slots.size() > (1u << 26))
+        throw runtime_error("Expression is too large for the JIT");
+
+    Generator<T> generator(compiled.program, compiled.registers, compiled.result);
+    size_t dataOffset = generator.emit();
+    vector<uint8_t>& bytes = generator.code();
+
+    // Данные в начале отображения: маска знака (16 байт), затем константы; код
+    // начинается с выровненного смещения. После записи страницы становятся R+X.
+    size_t dataSize = cell + sizeof(T) * compiled.constants.size();
+    size_t codeOffset = (dataSize + 63) & ~size_t(63);
+    size = codeOffset + bytes.size();
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        memory = nullptr;
+        throw runtime_error("Cannot allocate memory for JIT code");
+    }
+    auto* base = static_cast<uint8_t*>(memory);
+
+    uint64_t sign[2] = {0x8000000000000000ULL, is_same_v<T, double> ? 0 : 0x8000000000000000ULL};
+    memcpy(base, sign, sizeof(sign));
+    if (!compiled.constants.empty())
+        memcpy(base + cell, compiled.constants.data(), sizeof(T) * compiled.constants.size());
+    uint64_t address = reinterpret_cast<uint64_t>(base);
+    memcpy(&bytes[dataOffset], &address, sizeof(address));
+    memcpy(base + codeOffset, bytes.data(), bytes.size());
+    code = bytes.size();
+
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        memory = nullptr;
+        throw runtime_error("Cannot make JIT code executable");
+    }
+    entry = reinterpret_cast<Function>(base + codeOffset);
+#else
+    throw runtime_error("JIT is not supported on this platform");
+#endif
+}
+
+template <typename T>
+JitExpression<T>::JitExpression(JitExpression&& other) noexcept
+    : memory(other.memory), size(other.size), code(other.code), entry(other.entry),
+      slots(move(other.slots))
+{
+    other.memory = nullptr;
+    other.entry = nullptr;
+}
+
+template <typename T>
+JitExpression<T>& JitExpression<T>::operator=(JitExpression&& other) noexcept {
+    // Прежний код освободится в деструкторе other
+    swap(memory, other.memory);
+    swap(size, other.size);
+    swap(code, other.code);
+    swap(entry, other.entry);
+    swap(slots, other.slots);
+    return *this;
+}
+
+template <typename T>
+JitExpression<T>::~JitExpression() {
+#ifdef EXPRESSION_JIT_X86_64
+    if (memory) munmap(memory, size);
+#endif
+}
+
+template <typename T>
+T JitExpression<T>::evaluate(const map<string, T>& variables) const {
+    vector<T> values;
+    values.reserve(slots.size());
+    for (const string& name : slots) {
+        auto it = variables.find(name);
+        if (it == variables.end()) throw runtime_error("Undefined variable: " + name);
+        values.push_back(it->second);
+    }
+    return entry(values.data());
+}
+
+// Явное инстанцирование шаблонов
+template class JitExpression<double>;
+template class JitExpression<complex<double>>;
@@ -0,0 +1,856 @@
+#ifndef EXPRESSION_KERNELS_HPP
+#define EXPRESSION_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <complex>
+#include <algorithm>
+
+// Векторные ядра для пакетного вычисления.
+//
+// Циклы написаны без ветвлений и без вызовов libm, чтобы компилятор мог
+// векторизовать их (-O3). На x86-64 каждое ядро собирается в нескольких
+// вариантах (AVX-512, AVX2, базовый SSE2) с выбором при загрузке; на AArch64
+// базовым набором уже является NEON.
+//
+// Трансцендентные функции считаются полиномиальными приближениями с
+// редукцией аргумента. Редкие дорожки вне области приближения (большие
+// аргументы, нули, бесконечности, NaN, субнормальные числа) помечаются NaN
+// и затем пересчитываются скалярной функцией из <cmath>, поэтому результат
+// совпадает с libm в пределах нескольких ulp.
+
+// EXPRESSION_NO_TARGET_CLONES отключает варианты, например для сборки с
+// ThreadSanitizer, который не поддерживает ifunc-диспетчеризацию.
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute) && \
+    !defined(EXPRESSION_NO_TARGET_CLONES)
+#if __has_attribute(target_clones)
+#define EXPRESSION_SIMD __attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+#ifndef EXPRESSION_SIMD
+#define EXPRESSION_SIMD
+#endif
+
+namespace kernels {
+
+// Размер плитки для ядер, которым нужен исходный аргумент после записи результата
+constexpr std::size_t tile = 64;
+
+inline std::uint64_t bits(double x) {
+    std::uint64_t u;
+    std::memcpy(&u, &x, sizeof u);
+    return u;
+}
+
+inline double fromBits(std::uint64_t u) {
+    double x;
+    std::memcpy(&x, &u, sizeof x);
+    return x;
+}
+
+// Прибавление 1.5 * 2^52 округляет к ближайшему целому, а младшие биты
+// мантиссы суммы содержат это целое в дополнительном коде
+constexpr double roundMagic = 0x1.8p52;
+
+constexpr double log2e = 1.44269504088896338700e+00;
+constexpr double ln2Hi = 6.93147180369123816490e-01;
+constexpr double ln2Lo = 1.90821492927058770002e-10;
+constexpr double sqrt2 = 1.41421356237309514547e+00;
+
+// NaN для дорожек вне области приближения. Маска вместо тернарного оператора:
+// иначе компилятор переносит вычисление в ветвь и не может убрать ветвление
+inline double markInvalid(double v, bool valid) {
+    std::uint64_t nan = valid ? 0 : 0x7ff8000000000000ULL;
+    return fromBits(bits(v) | nan);
+}
+
+inline bool isFinite(double x) {
+    return x - x == 0.0;
+}
+
+// exp(hi + lo) для hi в [-708, 709]
+inline double expCore(double hi, double lo) {
+    double t = hi * log2e + roundMagic;
+    double n = t - roundMagic;
+    std::uint64_t k = bits(t) - bits(roundMagic);
+    double r = (hi - n * ln2Hi) - n * ln2Lo + lo;
+    double p = 1.0 / 6227020800.0;
+    p = p * r + 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+    return p * fromBits((k + 1023) << 52);
+}
+
+inline bool expInRange(double x) {
+    return (x >= -708.0) & (x <= 709.0);
+}
+
+// Разложение положительного нормального x = 2^e * (1 + f), (1 + f) в [sqrt(1/2), sqrt(2))
+struct LogParts {
+    double e, f, s, hfsq, r;
+};
+
+inline LogParts logParts(double x) {
+    std::uint64_t u = bits(x);
+    std::uint64_t biased = u >> 52;
+    std::uint64_t mantissa = (u & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+    double e = fromBits(0x4330000000000000ULL | biased) - 0x1p52 - 1023.0;
+    // Деление на 2 через показатель: условное умножение мешает if-conversion
+    bool big = fromBits(mantissa) > sqrt2;
+    double m = fromBits(mantissa - (big ? 0x0010000000000000ULL : 0));
+    e += big ? 1.0 : 0.0;
+    LogParts p;
+    p.e = e;
+    p.f = m - 1.0;
+    p.s = p.f / (2.0 + p.f);
+    double z = p.s * p.s;
+    p.r = z * (6.666666666666735130e-01 + z * (3.999999999940941908e-01 +
+          z * (2.857142874366239149e-01 + z * (2.222219843214978396e-01 +
+          z * (1.818357216161805012e-01 + z * (1.531383769920937332e-01 +
+          z * 1.479819860511658591e-01))))));
+    p.hfsq = 0.5 * p.f * p.f;
+    return p;
+}
+
+inline double logCore(double x) {
+    LogParts p = logParts(x);
+    return p.e * ln2Hi - ((p.hfsq - (p.s * (p.hfsq + p.r) + p.e * ln2Lo)) - p.f);
+}
+
+inline bool logInRange(double x) {
+    return (x >= DBL_MIN) & (x <= DBL_MAX);
+}
+
+// Синус и косинус на [-pi/4, pi/4]
+inline double sinPoly(double r) {
+    double z = r * r;
+    double p = 1.58969099521155010221e-10;
+    p = p * z - 2.50507602534068634195e-08;
+    p = p * z + 2.75573137070700676789e-06;
+    p = p * z - 1.98412698298579493134e-04;
+    p = p * z + 8.33333333332248946124e-03;
+    p = p * z - 1.66666666666666324348e-01;
+    return r + r * z * p;
+}
+
+inline double cosPoly(double r) {
+    double z = r * r;
+    double p = -1.13596475577881948265e-11;
+    p = p * z + 2.08757232129817482790e-09;
+    p = p * z - 2.75573143513906633035e-07;
+    p = p * z + 2.48015872894767294178e-05;
+    p = p * z - 1.38888888888741095749e-03;
+    p = p * z + 4.16666666666666019037e-02;
+    double hz = 0.5 * z;
+    double w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + z * z * p);
+}
+
+constexpr double twoOverPi = 6.36619772367581382433e-01;
+constexpr double pio2_1 = 1.57079632673412561417e+00;
+constexpr double pio2_2 = 6.07710050630396597660e-11;
+constexpr double pio2_2t = 2.02226624879595063154e-21;
+
+// Редукция Коди-Уэйта по pi/2 точна при |x| < 2^20
+inline bool trigInRange(double x) {
+    return (x >= -1e5) & (x <= 1e5);
+}
+
+inline void sinCosCore(double x, double& s, double& c) {
+    double t = x * twoOverPi + roundMagic;
+    double n = t - roundMagic;
+    std::uint64_t q = bits(t) - bits(roundMagic);
+    double r = ((x - n * pio2_1) - n * pio2_2) - n * pio2_2t;
+    double ps = sinPoly(r);
+    double pc = cosPoly(r);
+    bool swap = (q & 1) != 0;
+    double sv = swap ? pc : ps;
+    double cv = swap ? ps : pc;
+    s = (q & 2) ? -sv : sv;
+    c = ((q + 1) & 2) ? -cv : cv;
+}
+
+// atan на [0, 1]
+inline double atanUnit(double x) {
+    bool mid = (x >= 0.4375) & (x < 0.6875);
+    bool high = x >= 0.6875;
+    double rHigh = (x - 1.0) / (x + 1.0);
+    double rMid = (2.0 * x - 1.0) / (2.0 + x);
+    double reduced = high ? rHigh : (mid ? rMid : x);
+    double hi = high ? 7.85398163397448278999e-01 : (mid ? 4.63647609000806093515e-01 : 0.0);
+    double lo = high ? 3.06161699786838301793e-17 : (mid ? 2.26987774529616870924e-17 : 0.0);
+    double z = reduced * reduced;
+    double w = z * z;
+    double s1 = z * (3.33333333333329318027e-01 + w * (1.42857142725034663711e-01 +
+                w * (9.09088713343650656196e-02 + w * (6.66107313738753120669e-02 +
+                w * (4.97687799461593236017e-02 + w * 1.62858201153657823623e-02)))));
+    double s2 = w * (-1.99999999998764832476e-01 + w * (-1.11111104054623557880e-01 +
+                w * (-7.69187620504482999495e-02 + w * (-5.83357013379057348645e-02 +
+                w * -3.65315727442169155270e-02))));
+    return hi - ((reduced * (s1 + s2) - lo) - reduced);
+}
+
+constexpr double pi = 3.14159265358979311600e+00;
+constexpr double piLo = 1.22464679914735317720e-16;
+constexpr double pio2 = 1.57079632679489655800e+00;
+constexpr double pio2Lo = 6.12323399573676603587e-17;
+
+inline double atan2Core(double y, double x) {
+    double ay = std::fabs(y), ax = std::fabs(x);
+    bool steep = ay > ax;
+    double num = steep ? ax : ay;
+    double den = steep ? ay : ax;
+    double a = atanUnit(num / den);
+    double complement = (pio2 - a) + pio2Lo;
+    a = steep ? complement : a;
+    double reflected = (pi - a) + piLo;
+    a = x < 0.0 ? reflected : a;
+    return std::copysign(a, y);
+}
+
+inline bool atan2InRange(double y, double x) {
+    return isFinite(x) & isFinite(y) & ((x != 0.0) | (y != 0.0));
+}
+
+// Разбиение Вельткампа и точное произведение Деккера без FMA
+inline void twoProduct(double a, double b, double& p, double& e) {
+    const double split = 134217729.0;
+    double ca = split * a, cb = split * b;
+    double ah = ca - (ca - a), bh = cb - (cb - b);
+    double al = a - ah, bl = b - bh;
+    p = a * b;
+    e = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+}
+
+// Старшая половина числа: младшие 32 бита мантиссы обнулены, поэтому
+// произведение двух таких чисел точно
+inline double highWord(double x) {
+    return fromBits(bits(x) & 0xffffffff00000000ULL);
+}
+
+// log2 положительного нормального x в двойной-двойной точности, t1 + t2, как в
+// __ieee754_pow из fdlibm: x = 2^e * m, m приводится к опорной точке 1 или 1.5,
+// s = (m - b) / (m + b) и s^3 и старшие степени считаются с хвостами, так что
+// относительная погрешность около 2^-64. Ошибку логарифма pow умножает на y,
+// и логарифм с точностью обычного double даёт десятки ulp при |y log x| ~ 700
+inline void log2Parts(double x, double& t1, double& t2) {
+    std::uint64_t u = bits(x);
+    std::uint64_t biased = u >> 52;
+    std::uint64_t j = (u >> 32) & 0x000fffff;
+    // m >= sqrt(3) делится на 2, m в [sqrt(3/2), sqrt(3)) приводится к 1.5
+    bool half = j >= 0xbb67a;
+    bool mid = (j > 0x3988e) & !half;
+    std::uint64_t high = (j | 0x3ff00000) - (half ? 0x00100000 : 0);
+    double e = fromBits(0x4330000000000000ULL | biased) - 0x1p52 - 1023.0;
+    e += half ? 1.0 : 0.0;
+    double m = fromBits((high << 32) | (u & 0xffffffffULL));
+    double b = mid ? 1.5 : 1.0;
+
+    // s = sh + sl; th + tl = m + b точно
+    double num = m - b;
+    double inv = 1.0 / (m + b);
+    double s = num * inv;
+    double sh = highWord(s);
+    double th = fromBits((((high >> 1) | 0x20000000) + 0x00080000 +
+                          (mid ? 0x00040000 : 0)) << 32);
+    double tl = m - (th - b);
+    double sl = inv * ((num - sh * th) - sh * tl);
+
+    // log(m / b) = 2s + 2s^3/3 + s^4 * P(s^2)
+    double z = s * s;
+    double r = z * z * (5.99999999999994648725e-01 + z * (4.28571428578550184252e-01 +
+               z * (3.33333329818377432918e-01 + z * (2.72728123808534006489e-01 +
+               z * (2.30660745775561754067e-01 + z * 2.06975017800338417784e-01)))));
+    r += sl * (sh + s);
+    double sh2 = sh * sh;
+    double ph = highWord(3.0 + sh2 + r);
+    double pl = r - ((ph - 3.0) - sh2);
+    double vh = sh * ph;
+    double vl = sl * ph + pl * s;
+    double wh = highWord(vh + vl);
+    double wl = vl - (wh - vh);
+
+    // Умножение на 2 / (3 ln 2) и прибавление e + log2(b)
+    const double cp = 9.61796693925975554329e-01;
+    const double cpHi = 9.61796700954437255859e-01;
+    const double cpLo = -7.02846165095275826516e-09;
+    double dh = mid ? 5.84962487220764160156e-01 : 0.0;
+    double dl = mid ? 1.35003920212974897128e-08 : 0.0;
+    double zh = cpHi * wh;
+    double zl = cpLo * wh + wl * cp + dl;
+    t1 = highWord(((zh + zl) + dh) + e);
+    t2 = zl - (((t1 - e) - dh) - zh);
+}
+
+// x^y = exp(y * log x): y log2 x в двойной-двойной точности переводится в
+// натуральный логарифм и передаётся в expCore вместе с хвостом
+inline double powCore(double x, double y) {
+    double ax = std::fabs(x);
+    double t1, t2;
+    log2Parts(ax, t1, t2);
+    // y1 и t1 - старшие половины, их произведение точно
+    double y1 = highWord(y);
+    double ph = y1 * t1;
+    double pl = (y - y1) * t1 + y * t2;
+    // Умножение на ln 2 = lnHi + lnLo, lnHi тоже старшая половина
+    const double ln2 = 6.93147180559945286227e-01;
+    const double lnHi = 6.93147182464599609375e-01;
+    const double lnLo = -1.90465429995776804525e-09;
+    double t = highWord(ph + pl);
+    double a = t * lnHi;
+    double b = (pl - (t - ph)) * ln2 + t * lnLo;
+    double hi = a + b;
+    double lo = b - (hi - a);
+    double yt = y + roundMagic;
+    bool integer = yt - roundMagic == y;
+    // Побитовые операции вместо && и ||, чтобы цикл оставался без ветвлений
+    bool valid = (ax >= DBL_MIN) & (ax <= DBL_MAX) & (std::fabs(y) < 0x1p51) &
+                 ((x > 0.0) | integer) & (hi >= -708.0) & (hi <= 709.0);
+    // Знак меняется у отрицательного основания при нечётном показателе
+    std::uint64_t flip = (bits(yt) << 63) & bits(x);
+    double v = fromBits(bits(expCore(hi, lo)) ^ flip);
+    return markInvalid(v, valid);
+}
+
+// Дорожки, помеченные NaN, пересчитываются скалярно
+template <typename Scalar>
+inline void fixup(const double* x, double* out, std::size_t m, Scalar scalar) {
+    for (std::size_t j = 0; j < m; ++j) {
+        if (out[j] != out[j]) out[j] = scalar(x[j]);
+    }
+}
+
+// Поэлементные операции; out может совпадать с любым операндом
+EXPRESSION_SIMD
+inline void add(const double* a, const double* b, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = a[i] + b[i];
+}
+
+EXPRESSION_SIMD
+inline void subtract(const double* a, const double* b, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = a[i] - b[i];
+}
+
+EXPRESSION_SIMD
+inline void multiply(const double* a, const double* b, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = a[i] * b[i];
+}
+
+EXPRESSION_SIMD
+inline void divide(const double* a, const double* b, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = a[i] / b[i];
+}
+
+EXPRESSION_SIMD
+inline void negate(const double* a, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = -a[i];
+}
+
+// Поправка суммы по Кахану: неконечные значения заменяются нулём
+EXPRESSION_SIMD
+inline void compensation(const double* a, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = isFinite(a[i]) ? a[i] : 0.0;
+}
+
+inline void fill(double value, double* out, std::size_t n) {
+    std::fill(out, out + n, value);
+}
+
+EXPRESSION_SIMD
+inline void exp(const double* x, double* out, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        const double* xs = x + base;
+        double tmp[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double v = expCore(xs[j], 0.0);
+            tmp[j] = markInvalid(v, expInRange(xs[j]));
+        }
+        fixup(xs, tmp, m, [](double v) { return std::exp(v); });
+        std::copy(tmp, tmp + m, out + base);
+    }
+}
+
+EXPRESSION_SIMD
+inline void log(const double* x, double* out, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        const double* xs = x + base;
+        double tmp[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double v = logCore(xs[j]);
+            tmp[j] = markInvalid(v, logInRange(xs[j]));
+        }
+        fixup(xs, tmp, m, [](double v) { return std::log(v); });
+        std::copy(tmp, tmp + m, out + base);
+    }
+}
+
+EXPRESSION_SIMD
+inline void sin(const double* x, double* out, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        const double* xs = x + base;
+        double tmp[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double s, c;
+            sinCosCore(xs[j], s, c);
+            tmp[j] = markInvalid(s, trigInRange(xs[j]));
+        }
+        fixup(xs, tmp, m, [](double v) { return std::sin(v); });
+        std::copy(tmp, tmp + m, out + base);
+    }
+}
+
+EXPRESSION_SIMD
+inline void cos(const double* x, double* out, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        const double* xs = x + base;
+        double tmp[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double s, c;
+            sinCosCore(xs[j], s, c);
+            tmp[j] = markInvalid(c, trigInRange(xs[j]));
+        }
+        fixup(xs, tmp, m, [](double v) { return std::cos(v); });
+        std::copy(tmp, tmp + m, out + base);
+    }
+}
+
+// Синус и косинус за одну редукцию аргумента
+EXPRESSION_SIMD
+inline void sincos(const double* x, double* s, double* c, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        const double* xs = x + base;
+        double ts[tile], tc[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double sv, cv;
+            sinCosCore(xs[j], sv, cv);
+            bool ok = trigInRange(xs[j]);
+            ts[j] = markInvalid(sv, ok);
+            tc[j] = markInvalid(cv, ok);
+        }
+        fixup(xs, ts, m, [](double v) { return std::sin(v); });
+        fixup(xs, tc, m, [](double v) { return std::cos(v); });
+        std::copy(ts, ts + m, s + base);
+        std::copy(tc, tc + m, c + base);
+    }
+}
+
+EXPRESSION_SIMD
+inline void atan2(const double* y, const double* x, double* out, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        const double* ys = y + base;
+        const double* xs = x + base;
+        double tmp[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double v = atan2Core(ys[j], xs[j]);
+            tmp[j] = markInvalid(v, atan2InRange(ys[j], xs[j]));
+        }
+        for (std::size_t j = 0; j < m; ++j) {
+            if (tmp[j] != tmp[j]) tmp[j] = std::atan2(ys[j], xs[j]);
+        }
+        std::copy(tmp, tmp + m, out + base);
+    }
+}
+
+EXPRESSION_SIMD
+inline void pow(const double* x, const double* y, double* out, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        const double* xs = x + base;
+        const double* ys = y + base;
+        double tmp[tile];
+        for (std::size_t j = 0; j < m; ++j) tmp[j] = powCore(xs[j], ys[j]);
+        for (std::size_t j = 0; j < m; ++j) {
+            if (tmp[j] != tmp[j]) tmp[j] = std::pow(xs[j], ys[j]);
+        }
+        std::copy(tmp, tmp + m, out + base);
+    }
+}
+
+// Степени с постоянным показателем в том же порядке операций, что power.hpp
+EXPRESSION_SIMD
+inline void square(const double* a, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = a[i] * a[i];
+}
+
+EXPRESSION_SIMD
+inline void reciprocal(const double* a, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = 1.0 / a[i];
+}
+
+EXPRESSION_SIMD
+inline void sqrt(const double* a, double* out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = std::sqrt(a[i]);
+}
+
+// x^n двоичным возведением: проходы по плитке вместо цикла по битам на элемент
+EXPRESSION_SIMD
+inline void powi(const double* x, int exponent, double* out, std::size_t n) {
+    unsigned k = exponent < 0 ? 0u - static_cast<unsigned>(exponent) : static_cast<unsigned>(exponent);
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double b[tile], r[tile];
+        std::copy(x + base, x + base + m, b);
+        bool first = true;
+        for (unsigned bits = k; bits; bits >>= 1) {
+            if (bits & 1) {
+                if (first) std::copy(b, b + m, r);
+                else for (std::size_t j = 0; j < m; ++j) r[j] *= b[j];
+                first = false;
+            }
+            if (bits > 1) for (std::size_t j = 0; j < m; ++j) b[j] *= b[j];
+        }
+        if (first) std::fill(r, r + m, 1.0);
+        if (exponent < 0) for (std::size_t j = 0; j < m; ++j) r[j] = 1.0 / r[j];
+        std::copy(r, r + m, out + base);
+    }
+}
+
+// Комплексные ядра над раздельными массивами действительных и мнимых частей
+// (структура массивов). Дорожки с неконечным результатом пересчитываются
+// через std::complex.
+namespace soa {
+
+using Complex = std::complex<double>;
+
+template <typename Scalar>
+inline void fixup(const double* ar, const double* ai, double* outR, double* outI,
+                  std::size_t m, Scalar scalar) {
+    for (std::size_t j = 0; j < m; ++j) {
+        if (!(isFinite(outR[j]) && isFinite(outI[j]))) {
+            Complex v = scalar(Complex(ar[j], ai[j]));
+            outR[j] = v.real();
+            outI[j] = v.imag();
+        }
+    }
+}
+
+EXPRESSION_SIMD
+inline void multiply(const double* ar, const double* ai, const double* br, const double* bi,
+                     double* outR, double* outI, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        double re = ar[i] * br[i] - ai[i] * bi[i];
+        double im = ar[i] * bi[i] + ai[i] * br[i];
+        outR[i] = re;
+        outI[i] = im;
+    }
+}
+
+// Деление по Смиту в том же порядке операций и с тем же масштабированием,
+// что у __divdc3 из libgcc, которым делит std::complex: результат совпадает
+// побитово, включая знаки нулей (1/(-3.5-0i) = -0.2857+0i с мнимой -0).
+// Выбор ветви - через условные присваивания, поэтому цикл векторизуется.
+EXPRESSION_SIMD
+inline void divide(const double* ar, const double* ai, const double* br, const double* bi,
+                   double* outR, double* outI, std::size_t n) {
+    const double big = DBL_MAX / 2.0;
+    const double small = DBL_EPSILON;
+    const double up = 1.0 / DBL_EPSILON;
+    const double limit = big * small;
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double tr[tile], ti[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            std::size_t i = base + j;
+            double a = ar[i], b = ai[i], c = br[i], d = bi[i];
+            // p - большая по модулю часть делителя, q - меньшая
+            bool steep = std::fabs(c) < std::fabs(d);
+            double p = steep ? d : c, q = steep ? c : d;
+            double fa = std::fabs(a), fb = std::fabs(b), fp = std::fabs(p);
+            bool tiny = (fp < small) |
+                        ((fa < DBL_MIN) & (fb < limit) & (fp < limit)) |
+                        ((fb < DBL_MIN) & (fa < limit) & (fp < limit));
+            double scale = fp >= big ? 0.5 : tiny ? up : 1.0;
+            a *= scale;
+            b *= scale;
+            p *= scale;
+            q *= scale;
+            double ratio = q / p;
+            double denom = q * ratio + p;
+            // При субнормальном ratio libgcc делит на p раньше умножения на q
+            bool normal = std::fabs(ratio) > DBL_MIN;
+            double sa = normal ? a * ratio : q * (a / p);
+            double sb = normal ? b * ratio : q * (b / p);
+            tr[j] = (steep ? sa + b : sb + a) / denom;
+            ti[j] = (steep ? sb - a : b - sa) / denom;
+        }
+        // Бесконечности и NaN libgcc разбирает отдельно
+        for (std::size_t j = 0; j < m; ++j) {
+            if (!(isFinite(tr[j]) && isFinite(ti[j]))) {
+                std::size_t i = base + j;
+                Complex v = Complex(ar[i], ai[i]) / Complex(br[i], bi[i]);
+                tr[j] = v.real();
+                ti[j] = v.imag();
+            }
+        }
+        std::copy(tr, tr + m, outR + base);
+        std::copy(ti, ti + m, outI + base);
+    }
+}
+
+inline void exp(const double* ar, const double* ai, double* outR, double* outI, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double ea[tile], s[tile], c[tile];
+        kernels::exp(ar + base, ea, m);
+        kernels::sincos(ai + base, s, c, m);
+        for (std::size_t j = 0; j < m; ++j) {
+            s[j] *= ea[j];
+            c[j] *= ea[j];
+        }
+        fixup(ar + base, ai + base, c, s, m, [](Complex z) { return std::exp(z); });
+        std::copy(c, c + m, outR + base);
+        std::copy(s, s + m, outI + base);
+    }
+}
+
+// Действительная часть log z - это log|z|. У единичной окружности
+// log(re^2 + im^2) теряет почти все знаки, поэтому там берётся
+// log1p(re^2 + im^2 - 1), где сумма считается по точным произведениям
+// Деккера, а log1p(t) = log(u) * t / (u - 1) при u = 1 + t (приём Голдберга)
+inline void log(const double* ar, const double* ai, double* outR, double* outI, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double norm[tile], arg[tile], shift[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double re = ar[base + j], im = ai[base + j];
+            double sq = re * re + im * im;
+            double xx, ex, yy, ey;
+            twoProduct(re, re, xx, ex);
+            twoProduct(im, im, yy, ey);
+            // Сложения с точной ошибкой: (xx - 1) + yy
+            double a = xx - 1.0;
+            double ab = a - xx;
+            double ea = (xx - (a - ab)) + (-1.0 - ab);
+            double s2 = a + yy;
+            double sb = s2 - a;
+            double es = (a - (s2 - sb)) + (yy - sb);
+            double t = s2 + (ea + es + ex + ey);
+            bool near = (sq > 0.5) & (sq < 2.0);
+            shift[j] = near ? t : 0.0;
+            norm[j] = near ? 1.0 + t : sq;
+        }
+        kernels::log(norm, norm, m);
+        kernels::atan2(ai + base, ar + base, arg, m);
+        for (std::size_t j = 0; j < m; ++j) {
+            double re = ar[base + j], im = ai[base + j];
+            double sq = re * re + im * im;
+            double t = shift[j], u = 1.0 + t;
+            double near = u == 1.0 ? t : norm[j] * (t / (u - 1.0));
+            norm[j] = 0.5 * ((sq > 0.5) & (sq < 2.0) ? near : norm[j]);
+        }
+        // |z|^2 переполнился или ушёл в субнормальные числа
+        for (std::size_t j = 0; j < m; ++j) {
+            double re = ar[base + j], im = ai[base + j];
+            double sq = re * re + im * im;
+            if (!(sq >= DBL_MIN && sq <= DBL_MAX)) norm[j] = std::log(std::hypot(re, im));
+        }
+        fixup(ar + base, ai + base, norm, arg, m, [](Complex z) { return std::log(z); });
+        std::copy(norm, norm + m, outR + base);
+        std::copy(arg, arg + m, outI + base);
+    }
+}
+
+// cosh и sinh от мнимой части для sin/cos комплексного аргумента
+inline void coshSinh(const double* b, double* ch, double* sh, std::size_t m) {
+    double e[tile];
+    kernels::exp(b, e, m);
+    for (std::size_t j = 0; j < m; ++j) {
+        double inv = 1.0 / e[j];
+        double x = b[j], z = x * x;
+        // Ряд Тейлора для |x| < 1, где (e - 1/e) / 2 теряет точность
+        double p = 1.0 / 355687428096000.0;
+        p = p * z + 1.0 / 1307674368000.0;
+        p = p * z + 1.0 / 6227020800.0;
+        p = p * z + 1.0 / 39916800.0;
+        p = p * z + 1.0 / 362880.0;
+        p = p * z + 1.0 / 5040.0;
+        p = p * z + 1.0 / 120.0;
+        p = p * z + 1.0 / 6.0;
+        double series = x + x * z * p;
+        ch[j] = 0.5 * (e[j] + inv);
+        sh[j] = std::fabs(x) < 1.0 ? series : 0.5 * (e[j] - inv);
+    }
+}
+
+inline void sin(const double* ar, const double* ai, double* outR, double* outI, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double s[tile], c[tile], ch[tile], sh[tile];
+        kernels::sincos(ar + base, s, c, m);
+        coshSinh(ai + base, ch, sh, m);
+        for (std::size_t j = 0; j < m; ++j) {
+            s[j] *= ch[j];
+            c[j] *= sh[j];
+        }
+        fixup(ar + base, ai + base, s, c, m, [](Complex z) { return std::sin(z); });
+        std::copy(s, s + m, outR + base);
+        std::copy(c, c + m, outI + base);
+    }
+}
+
+inline void cos(const double* ar, const double* ai, double* outR, double* outI, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double s[tile], c[tile], ch[tile], sh[tile];
+        kernels::sincos(ar + base, s, c, m);
+        coshSinh(ai + base, ch, sh, m);
+        for (std::size_t j = 0; j < m; ++j) {
+            c[j] *= ch[j];
+            s[j] *= -sh[j];
+        }
+        fixup(ar + base, ai + base, c, s, m, [](Complex z) { return std::cos(z); });
+        std::copy(c, c + m, outR + base);
+        std::copy(s, s + m, outI + base);
+    }
+}
+
+// sin z и cos z с общими sincos действительной части и cosh, sinh мнимой;
+// выходы пишутся после поправок, поэтому могут совпадать со входом
+inline void sincos(const double* ar, const double* ai, double* sinR, double* sinI,
+                   double* cosR, double* cosI, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double s[tile], c[tile], ch[tile], sh[tile];
+        double sr[tile], si[tile], cr[tile], ci[tile];
+        kernels::sincos(ar + base, s, c, m);
+        coshSinh(ai + base, ch, sh, m);
+        for (std::size_t j = 0; j < m; ++j) {
+            sr[j] = s[j] * ch[j];
+            si[j] = c[j] * sh[j];
+            cr[j] = c[j] * ch[j];
+            ci[j] = s[j] * -sh[j];
+        }
+        fixup(ar + base, ai + base, sr, si, m, [](Complex z) { return std::sin(z); });
+        fixup(ar + base, ai + base, cr, ci, m, [](Complex z) { return std::cos(z); });
+        std::copy(sr, sr + m, sinR + base);
+        std::copy(si, si + m, sinI + base);
+        std::copy(cr, cr + m, cosR + base);
+        std::copy(ci, ci + m, cosI + base);
+    }
+}
+
+// Поправка суммы по Кахану: ноль, если неконечна хотя бы одна часть
+EXPRESSION_SIMD
+inline void compensation(const double* ar, const double* ai, double* outR, double* outI,
+                         std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        bool finite = isFinite(ar[i]) & isFinite(ai[i]);
+        outR[i] = finite ? ar[i] : 0.0;
+        outI[i] = finite ? ai[i] : 0.0;
+    }
+}
+
+// z^2 = (a^2 - b^2, 2ab); неконечные дорожки пересчитываются умножением std::complex
+inline void square(const double* ar, const double* ai, double* outR, double* outI,
+                   std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double tr[tile], ti[tile];
+        for (std::size_t j = 0; j < m; ++j) {
+            double a = ar[base + j], b = ai[base + j];
+            tr[j] = a * a - b * b;
+            ti[j] = 2.0 * a * b;
+        }
+        fixup(ar + base, ai + base, tr, ti, m, [](Complex z) { return z * z; });
+        std::copy(tr, tr + m, outR + base);
+        std::copy(ti, ti + m, outI + base);
+    }
+}
+
+inline void reciprocal(const double* ar, const double* ai, double* outR, double* outI,
+                       std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double one[tile], zero[tile];
+        std::fill(one, one + m, 1.0);
+        std::fill(zero, zero + m, 0.0);
+        divide(one, zero, ar + base, ai + base, outR + base, outI + base, m);
+    }
+}
+
+inline void sqrt(const double* ar, const double* ai, double* outR, double* outI,
+                 std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        Complex v = std::sqrt(Complex(ar[i], ai[i]));
+        outR[i] = v.real();
+        outI[i] = v.imag();
+    }
+}
+
+inline void powi(const double* ar, const double* ai, int exponent, double* outR, double* outI,
+                 std::size_t n) {
+    unsigned k = exponent < 0 ? 0u - static_cast<unsigned>(exponent) : static_cast<unsigned>(exponent);
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double br[tile], bi[tile], rr[tile], ri[tile];
+        std::copy(ar + base, ar + base + m, br);
+        std::copy(ai + base, ai + base + m, bi);
+        bool first = true;
+        for (unsigned bits = k; bits; bits >>= 1) {
+            if (bits & 1) {
+                if (first) {
+                    std::copy(br, br + m, rr);
+                    std::copy(bi, bi + m, ri);
+                } else {
+                    multiply(rr, ri, br, bi, rr, ri, m);
+                }
+                first = false;
+            }
+            if (bits > 1) square(br, bi, br, bi, m);
+        }
+        if (first) {
+            std::fill(rr, rr + m, 1.0);
+            std::fill(ri, ri + m, 0.0);
+        }
+        if (exponent < 0) reciprocal(rr, ri, rr, ri, m);
+        std::copy(rr, rr + m, outR + base);
+        std::copy(ri, ri + m, outI + base);
+    }
+}
+
+// z^w = exp(w * log z); нулевое основание обрабатывает std::pow
+inline void pow(const double* ar, const double* ai, const double* br, const double* bi,
+                double* outR, double* outI, std::size_t n) {
+    for (std::size_t base = 0; base < n; base += tile) {
+        std::size_t m = std::min(tile, n - base);
+        double lr[tile], li[tile];
+        log(ar + base, ai + base, lr, li, m);
+        multiply(lr, li, br + base, bi + base, lr, li, m);
+        exp(lr, li, lr, li, m);
+        for (std::size_t j = 0; j < m; ++j) {
+            std::size_t i = base + j;
+            if (!(isFinite(lr[j]) && isFinite(li[j])) || (ar[i] == 0.0 && ai[i] == 0.0)) {
+                Complex v = std::pow(Complex(ar[i], ai[i]), Complex(br[i], bi[i]));
+                lr[j] = v.real();
+                li[j] = v.imag();
+            }
+        }
+        std::copy(lr, lr + m, outR + base);
+        std::copy(li, li + m, outI + base);
+    }
+}
+
+} // namespace soa
+
+} // namespace kernels
+
+#endif // EXPRESSION_KERNELS_HPP
@@ -0,0 +1,7 @@
+#include "detail/parse_impl.hpp"
+
+using namespace std;
+
+// Явное инстанцирование шаблонов
+template Expression<double> Expression<double>::parse(string_view);
+template Expression<complex<double>> Expression<complex<double>>::parse(string_view);
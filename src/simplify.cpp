@@ -0,0 +1,11 @@
+#include "detail/simplify_impl.hpp"
+
+using namespace std;
+
+// Явное инстанцирование шаблонов
+template Expression<double> Expression<double>::simplify() const;
+template Expression<complex<double>> Expression<complex<double>>::simplify() const;
+template shared_ptr<Expression<double>::Node> Expression<double>::simplify(
+    const shared_ptr<Node>&);
+template shared_ptr<Expression<complex<double>>::Node> Expression<complex<double>>::simplify(
+    const shared_ptr<Node>&);
@@ -0,0 +1,7 @@
+#include "detail/stats_impl.hpp"
+
+using namespace std;
+
+// Явное инстанцирование шаблонов
+template ExpressionStats Expression<double>::stats() const;
+template ExpressionStats Expression<complex<double>>::stats() const;
@@ -0,0 +1,74 @@
+#include "detail/symbols.hpp"
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+// Имена лежат в блоках удваивающегося размера: блок k вмещает 2^k имён,
+// номер s попадает в блок старшего бита s + 1. Блоки не перемещаются,
+// поэтому name читает их без блокировки: count публикуется после записи
+// имени, и всё, что меньше count, уже записано.
+constexpr unsigned chunkCount = 32;
+
+struct State {
+    mutex lock;
+    // Ключи unordered_map не перемещаются при росте таблицы,
+    // поэтому блоки могут ссылаться прямо на них
+    unordered_map<string, SymbolTable::Symbol> ids;
+    const string** chunks[chunkCount] = {};
+    atomic<SymbolTable::Symbol> count{0};
+};
+
+State& state() {
+    // Не разрушается при выходе, как и таблица узлов
+    static State* s = new State;
+    return *s;
+}
+
+unsigned chunkOf(uint64_t position) {
+#if defined(__GNUC__)
+    return 63u - static_cast<unsigned>(__builtin_clzll(position));
+#else
+    unsigned k = 0;
+    while (position >> (k + 1)) ++k;
+    return k;
+#endif
+}
+
+} // namespace
+
+SymbolTable::Symbol SymbolTable::intern(const string& name) {
+    State& s = state();
+    lock_guard<mutex> guard(s.lock);
+    auto it = s.ids.find(name);
+    if (it != s.ids.end()) return it->second;
+    Symbol symbol = s.count.load(memory_order_relaxed);
+    if (symbol >= none) throw runtime_error("Too many variable names");
+    uint64_t position = uint64_t(symbol) + 1;
+    unsigned k = chunkOf(position);
+    if (!s.chunks[k]) s.chunks[k] = new const string*[size_t(1) << k];
+    it = s.ids.emplace(name, symbol).first;
+    s.chunks[k][position - (uint64_t(1) << k)] = &it->first;
+    s.count.store(symbol + 1, memory_order_release);
+    return symbol;
+}
+
+SymbolTable::Symbol SymbolTable::find(const string& name) {
+    State& s = state();
+    lock_guard<mutex> guard(s.lock);
+    auto it = s.ids.find(name);
+    return it != s.ids.end() ? it->second : none;
+}
+
+const string& SymbolTable::name(Symbol symbol) {
+    const State& s = state();
+    if (symbol >= s.count.load(memory_order_acquire))
+        throw out_of_range("Unknown variable symbol");
+    uint64_t position = uint64_t(symbol) + 1;
+    unsigned k = chunkOf(position);
+    return *s.chunks[k][position - (uint64_t(1) << k)];
+}
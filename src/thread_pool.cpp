@@ -0,0 +1,199 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Пул, в задаче которого работает текущий поток
+thread_local const void* currentPool = nullptr;
+
+// Отрезок [begin, end) фрагментов в одном слове: begin - младшие 32 бита
+uint64_t pack(uint64_t begin, uint64_t end) {
+    return (end << 32) | begin;
+}
+
+uint64_t beginOf(uint64_t range) {
+    return range & 0xffffffffULL;
+}
+
+uint64_t endOf(uint64_t range) {
+    return range >> 32;
+}
+
+} // namespace
+
+struct ThreadPool::State {
+    // Отрезки потоков лежат в разных строках кэша
+    struct alignas(64) Range {
+        atomic<uint64_t> bounds{0};
+    };
+
+    vector<thread> workers;
+    unique_ptr<Range[]> ranges;
+
+    // Одно задание за раз
+    mutex submit;
+
+    mutex lock;
+    condition_variable wake;
+    condition_variable finished;
+    uint64_t generation = 0;
+    bool stop = false;
+    const function<void(size_t)>* task = nullptr;
+    size_t participants = 0;
+    // Потоки пула, ещё не закончившие текущее задание
+    size_t active = 0;
+
+    atomic<bool> failed{false};
+    exception_ptr error;
+
+    bool pop(size_t self, size_t& chunk) {
+        atomic<uint64_t>& bounds = ranges[self].bounds;
+        uint64_t range = bounds.load(memory_order_acquire);
+        while (beginOf(range) < endOf(range)) {
+            if (bounds.compare_exchange_weak(range, pack(beginOf(range) + 1, endOf(range)),
+                                             memory_order_acq_rel, memory_order_acquire)) {
+                chunk = beginOf(range);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Забирает в свой пустой отрезок вторую половину чужого
+    bool steal(size_t self) {
+        for (size_t k = 1; k < participants; ++k) {
+            atomic<uint64_t>& victim = ranges[(self + k) % participants].bounds;
+            uint64_t range = victim.load(memory_order_acquire);
+            while (beginOf(range) < endOf(range)) {
+                uint64_t begin = beginOf(range);
+                uint64_t end = endOf(range);
+                uint64_t middle = begin + (end - begin) / 2;
+                if (victim.compare_exchange_weak(range, pack(begin, middle),
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+                    ranges[self].bounds.store(pack(middle, end), memory_order_release);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void work(size_t self) {
+        const void* outer = currentPool;
+        currentPool = this;
+        size_t chunk;
+        for (;;) {
+            if (!pop(self, chunk) && !(steal(self) && pop(self, chunk))) {
+                // Украденный отрезок могли успеть забрать, поэтому проверка повторяется
+                if (!anyLeft()) break;
+                continue;
+            }
+            if (failed.load(memory_order_relaxed)) continue;
+            try {
+                (*task)(chunk);
+            } catch (...) {
+                lock_guard<mutex> guard(lock);
+                if (!failed.exchange(true)) error = current_exception();
+            }
+        }
+        currentPool = outer;
+    }
+
+    bool anyLeft() const {
+        for (size_t i = 0; i < participants; ++i) {
+            uint64_t range = ranges[i].bounds.load(memory_order_acquire);
+            if (beginOf(range) < endOf(range)) return true;
+        }
+        return false;
+    }
+
+    void loop(size_t self) {
+        uint64_t seen = 0;
+        unique_lock<mutex> guard(lock);
+        for (;;) {
+            wake.wait(guard, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+            if (self >= participants) continue;
+            guard.unlock();
+            work(self);
+            guard.lock();
+            if (--active == 0) finished.notify_all();
+        }
+    }
+};
+
+ThreadPool::ThreadPool(size_t threads) : state(new State) {
+    if (threads == 0) threads = max<size_t>(1, thread::hardware_concurrency());
+    state->ranges.reset(new State::Range[threads]);
+    state->workers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) {
+        state->workers.emplace_back([s = state.get(), i] { s->loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(state->lock);
+        state->stop = true;
+    }
+    state->wake.notify_all();
+    for (thread& worker : state->workers) worker.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+size_t ThreadPool::size() const {
+    return state->workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& task, size_t limit) {
+    if (count == 0) return;
+    if (count > 0xffffffffULL) throw length_error("Too many chunks for ThreadPool::parallelFor");
+    size_t participants = min(limit ? limit : size(), size());
+    participants = min(participants, count);
+    if (participants <= 1 || currentPool) {
+        for (size_t i = 0; i < count; ++i) task(i);
+        return;
+    }
+
+    State& s = *state;
+    lock_guard<mutex> serial(s.submit);
+    for (size_t i = 0; i < participants; ++i) {
+        s.ranges[i].bounds.store(pack(count * i / participants, count * (i + 1) / participants),
+                                 memory_order_relaxed);
+    }
+    {
+        lock_guard<mutex> guard(s.lock);
+        s.task = &task;
+        s.participants = participants;
+        s.active = participants - 1;
+        s.failed.store(false, memory_order_relaxed);
+        s.error = nullptr;
+        ++s.generation;
+    }
+    s.wake.notify_all();
+    s.work(0);
+
+    unique_lock<mutex> guard(s.lock);
+    s.finished.wait(guard, [&] { return s.active == 0; });
+    s.task = nullptr;
+    if (s.error) {
+        exception_ptr error = s.error;
+        s.error = nullptr;
+        rethrow_exception(error);
+    }
+}